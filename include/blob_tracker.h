@@ -0,0 +1,53 @@
+#ifndef BLOB_TRACKER_H
+#define BLOB_TRACKER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "utility.h"
+
+extern "C" {
+    #include "vc.h"
+}
+
+// Resistência física seguida de frame para frame
+struct Track {
+    int id = 0;
+    OVC blob{};                     // Blob no último frame em que foi visto
+    int missed = 0;                 // Frames seguidos sem ser visto
+    int attempts = 0;               // Identificações das cores já tentadas
+    bool confirmed = false;         // Valor confirmado: as cores deixam de ser identificadas
+    bool rejected = false;          // Sem valor após todas as tentativas: deixa de ser identificada
+    std::string resistorValue;      // Valor mais votado
+    LabelColor labelColor;          // Cores da identificação que deu o valor mais votado
+    std::map<std::string, int> votes;
+
+    bool needsDecode() const { return !confirmed && !rejected; }
+    void vote(const std::string& value, const LabelColor& colors, int confirmVotes, int maxAttempts);
+    void fail(int maxAttempts);
+};
+
+// Associação dos blobs de cada frame às resistências do frame anterior, pela sobreposição das
+// caixas (IoU) ou, sem sobreposição suficiente, pela distância entre os centros de massa
+class BlobTracker {
+public:
+    explicit BlobTracker(double minIoU = 0.3, int maxMissed = 10, int confirmVotes = 3, int maxAttempts = 15)
+        : minIoU_(minIoU), maxMissed_(maxMissed), confirmVotes_(confirmVotes), maxAttempts_(maxAttempts) {}
+
+    // Devolve, para cada blob, a resistência correspondente (válida até à próxima chamada)
+    std::vector<Track*> update(const std::vector<OVC>& blobs);
+
+    void vote(Track& track, const std::string& value, const LabelColor& colors) { track.vote(value, colors, confirmVotes_, maxAttempts_); }
+    void fail(Track& track) { track.fail(maxAttempts_); }
+
+private:
+    std::vector<Track> tracks_;
+    int nextId_ = 1;
+    double minIoU_;
+    int maxMissed_;
+    int confirmVotes_;
+    int maxAttempts_;
+};
+
+#endif //BLOB_TRACKER_H
@@ -0,0 +1,63 @@
+#ifndef DEBUG_DUMP_H
+#define DEBUG_DUMP_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pipeline.h"
+
+extern "C" {
+    #include "vc.h"
+}
+
+// Opções das imagens de depuração (desligadas por omissão)
+struct DumpOptions {
+    int every = 0;              // Guardar um frame em cada every (0 = nenhum por amostragem)
+    bool onFailure = false;     // Guardar os frames com blobs em que a identificação falhou
+    int maxPending = 8;         // Máximo de imagens em memória à espera de escrita
+    std::string directory = ".";
+    std::string prefix;         // Prefixo dos nomes (p.ex. o nome do vídeo, no modo sem interface)
+
+    bool enabled() const { return every > 0 || onFailure; }
+};
+
+// Escrita de máscaras de depuração numa thread própria: quem grava copia a máscara para
+// um de maxPending buffers e segue; sem buffers livres, a imagem é descartada (e contada).
+// Os ficheiros chamam-se <directory>/<prefix><name>_<frame>.pbm.
+// Só pode haver uma thread a gravar (as filas são SPSC).
+class DebugDump {
+public:
+    DebugDump(const DumpOptions& options, int width, int height);
+    ~DebugDump();
+
+    DebugDump(const DebugDump&) = delete;
+    DebugDump& operator=(const DebugDump&) = delete;
+
+    bool enabled() const { return options_.enabled(); }
+    bool wants(long frame, bool failed) const;
+    bool dump(const char* name, long frame, const BVC* image);
+    void finish();
+    long written() const { return written_; }
+    long dropped() const { return dropped_; }
+
+private:
+    struct Item {
+        BVC* image = nullptr;
+        const char* name = nullptr;
+        long frame = 0;
+    };
+
+    void run();
+
+    DumpOptions options_;
+    std::vector<Item> items_;
+    SpscQueue<Item*> pending_;  // A escrever (thread que grava --> escritor)
+    SpscQueue<Item*> free_;     // Livres (escritor --> thread que grava)
+    std::atomic<long> written_{0};
+    std::atomic<long> dropped_{0};
+    std::thread writer_;
+};
+
+#endif //DEBUG_DUMP_H
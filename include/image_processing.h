@@ -2,11 +2,48 @@
 #define IMAGE_PROCESSING_H
 
 #include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
 
 extern "C" {
     #include "vc.h"
 }
 
+// Imagem emprestada de um PVC, devolvida ao conjunto quando sai de âmbito
+class PooledImage {
+public:
+    PooledImage(PVC* pool, int width, int height, int channels, int levels)
+        : pool_(pool), image_(vc_pool_acquire(pool, width, height, channels, levels)) {}
+    ~PooledImage() { if (image_ != nullptr) vc_pool_release(pool_, image_); }
+
+    PooledImage(const PooledImage&) = delete;
+    PooledImage& operator=(const PooledImage&) = delete;
+    PooledImage(PooledImage&& other) noexcept : pool_(other.pool_), image_(other.image_) { other.image_ = nullptr; }
+
+    IVC* get() const { return image_; }
+    IVC* operator->() const { return image_; }
+    explicit operator bool() const { return image_ != nullptr; }
+
+private:
+    PVC* pool_;
+    IVC* image_;
+};
+
+// Âmbito de uma arena: tudo o que for alocado nela é libertado no fim do âmbito (p.ex. de um frame)
+class ArenaScope {
+public:
+    explicit ArenaScope(AVC* arena) : arena_(arena) {}
+    ~ArenaScope() { vc_arena_reset(arena_); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    AVC* arena_;
+};
+
+IVC matToIVC(const cv::Mat& mat);
+cv::Mat ivcToMat(const IVC& image);
 void identifyBlobsColors(IVC* hsvCropImg, std::vector<std::pair<int, std::string>>& foundColors);
 
 #endif //IMAGE_PROCESSING_H
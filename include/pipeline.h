@@ -0,0 +1,146 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Espera ativa de uma etapa sem trabalho: cede o processador e, se a espera se prolongar,
+// adormece para não ocupar processadores de outros pipelines (spins = tentativas falhadas)
+inline void backoff(unsigned spins) {
+    if (spins < 64) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+
+// Fila limitada sem locks para um único produtor e um único consumidor (SPSC)
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {
+        size_t size = 1;
+        while (size < capacity_) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Só pode ser chamada pelo produtor
+    bool tryPush(const T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= capacity_) return false;
+
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Só pode ser chamada pelo consumidor
+    bool tryPop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Versões bloqueantes: esperam (backoff) enquanto a fila estiver cheia / vazia
+    void push(const T& value) {
+        for (unsigned spins = 0; !tryPush(value); spins++) backoff(spins);
+    }
+
+    T pop() {
+        T value;
+        for (unsigned spins = 0; !tryPop(value); spins++) backoff(spins);
+        return value;
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    const size_t capacity_;
+    // Índices em linhas de cache distintas, para o produtor e o consumidor não se invalidarem mutuamente
+    char padding0_[64];
+    std::atomic<size_t> head_{0}; // Próxima posição a ler (consumidor)
+    char padding1_[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail_{0}; // Próxima posição a escrever (produtor)
+    char padding2_[64 - sizeof(std::atomic<size_t>)];
+};
+
+
+// Primeira exceção lançada pelas etapas de um pipeline. Depois de uma falha as etapas continuam
+// a passar os elementos (sem os processar) até aos marcadores de fim, para nenhuma ficar bloqueada
+// numa fila cheia; a exceção é relançada pela thread que lançou as etapas, depois de as juntar
+class PipelineError {
+public:
+    // Regista a exceção em tratamento (só a primeira é guardada); chamar num bloco catch
+    void capture() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+        failed_.store(true, std::memory_order_release);
+    }
+
+    bool failed() const { return failed_.load(std::memory_order_acquire); }
+
+    void rethrow() const {
+        if (error_) std::rethrow_exception(error_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false};
+};
+
+
+// Reposição da ordem de elementos numerados (0, 1, 2, ...) que chegam fora de ordem,
+// desde que nenhum chegue mais de window posições à frente do próximo a sair
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window) : slots_(window > 0 ? window : 1) {}
+
+    bool insert(long sequence, const T& value) {
+        if (sequence < next_ || sequence >= next_ + static_cast<long>(slots_.size())) return false;
+
+        Slot& slot = slots_[sequence % slots_.size()];
+        slot.value = value;
+        slot.ready = true;
+        pending_++;
+        return true;
+    }
+
+    // Retira o próximo elemento em ordem, se já tiver chegado
+    bool next(T& value) {
+        Slot& slot = slots_[next_ % slots_.size()];
+        if (!slot.ready) return false;
+
+        value = std::move(slot.value);
+        slot.ready = false;
+        next_++;
+        pending_--;
+        return true;
+    }
+
+    bool empty() const { return pending_ == 0; }
+
+private:
+    struct Slot {
+        T value{};
+        bool ready = false;
+    };
+
+    std::vector<Slot> slots_;
+    long next_ = 0;
+    size_t pending_ = 0;
+};
+
+#endif //PIPELINE_H
@@ -0,0 +1,46 @@
+#ifndef RAW_FRAME_READER_H
+#define RAW_FRAME_READER_H
+
+#include <cstdio>
+#include <string>
+
+extern "C" {
+    #include "vc.h"
+}
+
+// Leitura de frames sem contentor nem descodificação, de um ficheiro, pipe ou stdin ("-"):
+// Y4M (YUV planar 4:2:0, 4:4:4 ou mono) ou RGB24 em bruto (dimensões dadas à parte)
+class RawFrameReader {
+public:
+    RawFrameReader() = default;
+    ~RawFrameReader();
+
+    RawFrameReader(const RawFrameReader&) = delete;
+    RawFrameReader& operator=(const RawFrameReader&) = delete;
+
+    bool open(const std::string& path, int width = 0, int height = 0, double frameRate = 0.0);
+    bool read(unsigned char* dst);
+    int toRGB(const unsigned char* src, const IVC* dst) const;
+    void close();
+
+    bool isOpened() const { return file_ != nullptr; }
+    bool isRGB() const { return format_ < 0; }  // Os frames já vêm em RGB24 (lidos diretamente para a imagem)
+    int width() const { return width_; }
+    int height() const { return height_; }
+    double frameRate() const { return frameRate_; }
+    size_t frameBytes() const { return frameBytes_; }
+
+private:
+    bool readY4MHeader();
+
+    FILE* file_ = nullptr;
+    bool y4m_ = false;
+    int format_ = -1;           // VC_YUV_* (-1 = RGB24)
+    int fullRange_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    double frameRate_ = 0.0;
+    size_t frameBytes_ = 0;
+};
+
+#endif //RAW_FRAME_READER_H
@@ -2,6 +2,7 @@
 #define RESISTOR_DETECTION_H
 
 #include <string>
+#include <vector>
 
 std::string calculateResistorValue(const std::vector<std::pair<int, std::string>>& foundColors);
 
@@ -1,6 +1,9 @@
 #pragma once
 #define VC_DEBUG
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifndef MAX
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #endif
@@ -16,6 +19,15 @@
 #define HSV_2_RGB(value) CONV_RANGE(value, 360, 255)
 
 #define COLOR_NAME_MAX 20 // Tamanho maximo do nome da cor
+#define VC_HSV_LUT_MAX 32 // Numero maximo de intervalos numa tabela de segmentacao
+
+// Formatos de YUV planar (vc_yuv_to_rgb)
+#define VC_YUV_MONO 0     // So luminancia
+#define VC_YUV_420 1      // Croma com metade da largura e da altura
+#define VC_YUV_444 2      // Croma com a resolucao total
+
+// Mascara de intervalos de uma tabela de segmentacao que aceitam o pixel (h, s, v)
+#define VC_HSV_LUT(lut, hb, sb, vb) ((lut)->h[hb] & (lut)->s[sb] & (lut)->v[vb])
 
 // Estrutura de uma imagem
 typedef struct {
@@ -23,7 +35,8 @@ typedef struct {
     int width, height;
     int channels;			// Binario/Cinzentos=1; RGB=3
     int levels;				// Binario=1; Cinzentos [1,255]; RGB [1,255]
-    int bytesperline;		// width * channels
+    int bytesperline;		// Bytes entre linhas (>= width * channels; maior numa vista)
+    int owndata;			// 1 se data foi alocado pela imagem; 0 numa vista sobre outra imagem
 } IVC;
 
 // Estrutura de um objeto
@@ -42,26 +55,117 @@ typedef struct {
     int vMin, vMax; // Intervalo de valor
 } Color;
 
+// Tabela de segmentacao HSV (um bit por intervalo)
+typedef struct {
+    unsigned int h[256];    // Intervalos que aceitam cada byte de matiz
+    unsigned int s[256];    // Intervalos que aceitam cada byte de saturacao
+    unsigned int v[256];    // Intervalos que aceitam cada byte de valor
+    int nranges;            // Numero de intervalos
+} SVC;
+
+// Estrutura de uma imagem binaria compactada (1 bit por pixel, bit 0 = pixel mais a esquerda)
+typedef struct {
+    uint64_t* data;
+    int width, height;
+    int wordsperline;       // (width + 63) / 64; os bits alem da largura sao sempre 0
+} BVC;
+
+// Segmento horizontal de pixeis de objeto (run)
+typedef struct {
+    int y;                  // Linha
+    int x0, x1;             // Primeira e ultima coluna
+    int label;              // Etiqueta do blob (0 = por etiquetar)
+} RUN;
+
+// Estrutura de uma mascara codificada em runs (RLE), ordenados por linha e coluna
+typedef struct {
+    RUN* runs;
+    int nruns, capacity;
+    int* rowstart;          // Indice do primeiro run de cada linha (height + 1 entradas)
+    int width, height;
+} RVC;
+
+// Zona de memoria temporaria (arena): alocacoes sequenciais, libertadas todas de uma vez
+typedef struct {
+    unsigned char* data;
+    size_t size, used;
+    size_t overflow;        // Bytes pedidos alem de size desde o ultimo reset
+    void* extra;            // Blocos alocados quando data esgotou (lista ligada)
+} AVC;
+
+// Conjunto de imagens reutilizaveis, atribuidas pela capacidade do buffer
+typedef struct {
+    IVC** images;
+    size_t* capacity;       // Bytes alocados em images[i]->data
+    int* inuse;
+    int count, max;
+} PVC;
+
+// Imagem PBM/PGM/PPM projetada em memoria a partir de um ficheiro
+typedef struct {
+    IVC image;              // Vista sobre os pixeis do ficheiro (em PBM, imagem propria descompactada)
+    unsigned char* base;    // Inicio do ficheiro em memoria
+    size_t size;            // Tamanho do ficheiro
+    size_t offset;          // Inicio dos pixeis (a seguir ao cabecalho)
+    int writable;           // 1 se foi criada por vc_image_map_create (as alteracoes ficam no ficheiro)
+    void* handle;           // Ficheiro a escrever no fim (apenas sem mmap)
+} MVC;
+
+// Numero de threads dos kernels (1 = em serie; 0 = uma por processador)
+int vc_set_threads(int nthreads);
+int vc_get_threads(void);
+
 // Alocar e Libertar uma Imagen
 IVC* vc_image_new(int width, int height, int channels, int levels);
 IVC* vc_image_free(IVC* image);
+int vc_image_view(IVC* view, const IVC* parent, int x, int y, int width, int height);
+
+// Memoria temporaria e imagens reutilizaveis
+AVC* vc_arena_new(size_t size);
+AVC* vc_arena_free(AVC* arena);
+void* vc_arena_alloc(AVC* arena, size_t size);
+void vc_arena_reset(AVC* arena);
+PVC* vc_pool_new(void);
+PVC* vc_pool_free(PVC* pool);
+IVC* vc_pool_acquire(PVC* pool, int width, int height, int channels, int levels);
+int vc_pool_release(PVC* pool, IVC* image);
 OVC* vc_binary_blob_labelling(const IVC* src, const IVC* dst, int* nlabels);
+OVC* vc_binary_blob_labelling32(const IVC* src, int* labels, int* nlabels);
 
 // Funções de Processamento de Imagem
 int vc_rgb_to_gray(const IVC* src, const IVC* dst);
+int vc_yuv_to_rgb(const unsigned char* src, int format, int fullrange, const IVC* dst);
 int vc_rgb_to_hsv(const IVC* srcdst, const IVC* dst);
+int vc_rgb_to_hsv_scalar(const IVC* src, const IVC* dst);
 int vc_hsv_segmentation(const IVC* src, const IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+void vc_hsv_lut_init(SVC* lut);
+int vc_hsv_lut_add(SVC* lut, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+int vc_hsv_segmentation_lut(const IVC* src, const IVC* dst, const SVC* lut, unsigned int mask);
+int vc_hsv_lut_classify(const IVC* src, const IVC* dst, const SVC* lut, int* firstx);
+int vc_rgb_to_hsv_mask(const IVC* src, const IVC* dst, const SVC* lut, unsigned int mask);
 int vc_gray_to_binary_midpoint(const IVC* src, const IVC* dst, int kernel);
 int vc_binary_erode(const IVC* src, const IVC* dst, int kernel);
+int vc_gray_erode_rect(const IVC* src, const IVC* dst, int kwidth, int kheight);
+int vc_gray_dilate_rect(const IVC* src, const IVC* dst, int kwidth, int kheight);
+int vc_gray_open_rect(const IVC* src, const IVC* dst, int kwidth, int kheight);
+int vc_gray_close_rect(const IVC* src, const IVC* dst, int kwidth, int kheight);
 int vc_binary_blob_info(const IVC* src, OVC* blobs, int nblobs);
+int vc_binary_blob_info32(const int* labels, int width, int height, OVC* blobs, int nblobs);
 int vc_draw_bounding_box(int x, int y, int largura, int altura, const IVC* isaida);
 int vc_gray_lowpass_mean_filter(const IVC* src, const IVC* dst);
+int vc_gray_box_mean(const IVC* src, const IVC* dst, int kernel);
+int vc_gray_box_stddev(const IVC* src, const IVC* dst, int kernel);
+int vc_gray_to_binary_bradley(const IVC* src, const IVC* dst, int kernel, float t);
+int vc_gray_to_binary_sauvola(const IVC* src, const IVC* dst, int kernel, float k, float r);
 int vc_center_of_mass(int x, int y, int xc, int yc, int largura, int altura, const IVC* isaida);
 
 
 // Leitura e Escrita de Imagens (PBM / PGM / PPM)
 IVC* vc_read_image(const char* filename);
 int vc_write_image(const char* filename, const IVC* image);
+MVC* vc_image_map(const char* filename);
+MVC* vc_image_map_create(const char* filename, int width, int height, int channels, int levels);
+MVC* vc_image_unmap(MVC* map);
 int vc_gray_negative(const IVC* srcdst);
 int vc_rgb_negative(const IVC* srcdst);
 int vc_rgb_get_red_gray(const IVC* srcdst);
@@ -75,10 +179,41 @@ int vc_binary_open(const IVC* src, const IVC* dst, int kernel);
 int vc_binary_close(const IVC* src, const IVC* dst, int kernel);
 int vc_gray_histogram_show(const IVC* src, const IVC* dst);
 int vc_gray_histogram_equalization(IVC* srcdst);
+int vc_histogram(const IVC* src, int channel, int* hist);
+void vc_histogram_equalization_lut(const int* hist, int levels, unsigned char* lut);
+int vc_image_apply_lut(const IVC* src, const IVC* dst, const unsigned char* lut);
+int vc_gray_clahe(const IVC* src, const IVC* dst, int tilesx, int tilesy, float cliplimit);
 int vc_desenha_bounding_box_rgb(const IVC* src, const OVC* blobs, int numeroBlobs);
 int vc_desenha_centro_massa_rgb(const IVC* src, const OVC* blobs, int numeroBlobs);
 int vc_gray_edge_prewitt(const IVC* src, const IVC* dst, float th);
+int vc_gray_edge_sobel(const IVC* src, const IVC* dst, float th);
 int vc_gray_lowpass_median_filter(const IVC* src, const IVC* dst);
+int vc_gray_median_filter(const IVC* src, const IVC* dst, int kernel);
 int vc_gray_highpass_filter(const IVC* src, const IVC* dst);
 int vc_gray_to_binary_bernson(const IVC* src, const IVC* dst, int kernel);
-int vc_clean_image(const IVC* src, const IVC* dst, OVC blob);
\ No newline at end of file
+int vc_clean_image(const IVC* src, const IVC* dst, OVC blob);
+
+// Imagens binarias compactadas (1 bit por pixel)
+BVC* vc_bitimage_new(int width, int height);
+BVC* vc_bitimage_free(BVC* image);
+int vc_gray_to_bitimage(const IVC* src, const BVC* dst);
+int vc_bitimage_to_gray(const BVC* src, const IVC* dst);
+int vc_bitimage_copy(const BVC* src, const BVC* dst);
+BVC* vc_bitimage_read_pbm(const char* filename);
+int vc_bitimage_write_pbm(const char* filename, const BVC* image);
+int vc_bitimage_erode(const BVC* src, const BVC* dst, int kwidth, int kheight);
+int vc_bitimage_dilate(const BVC* src, const BVC* dst, int kwidth, int kheight);
+int vc_bitimage_open(const BVC* src, const BVC* dst, int kwidth, int kheight);
+int vc_bitimage_close(const BVC* src, const BVC* dst, int kwidth, int kheight);
+long vc_bitimage_count(const BVC* src);
+int vc_bitimage_bbox(const BVC* src, OVC* box);
+
+// Mascaras codificadas em runs (RLE)
+RVC* vc_rle_new(int width, int height);
+RVC* vc_rle_free(RVC* rle);
+int vc_gray_to_rle(const IVC* src, RVC* dst);
+int vc_bitimage_to_rle(const BVC* src, RVC* dst);
+int vc_rle_to_gray(const RVC* src, const IVC* dst);
+OVC* vc_rle_blob_labelling(RVC* rle, int* nlabels);
+OVC* vc_rle_blob_labelling_arena(RVC* rle, int* nlabels, AVC* arena);
+int vc_rle_blob_info(const RVC* rle, OVC* blobs, int nblobs);
\ No newline at end of file
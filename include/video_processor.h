@@ -2,7 +2,43 @@
 #define VIDEO_PROCESSOR_H
 
 #include <opencv2/opencv.hpp>
+#include <set>
+#include <string>
+#include <vector>
 
-void processVideo(cv::VideoCapture& cap);
+#include "utility.h"
+#include "debug_dump.h"
+#include "raw_frame_reader.h"
+
+// Opções de processamento de um vídeo
+struct ProcessOptions {
+    std::string outputPath = ::outputPath;  // Vazio = sem vídeo de saída
+    bool display = true;      // Exibir os frames numa janela (false = modo sem interface)
+    DumpOptions dumps;        // Máscaras intermédias (fecho / erosão) para depuração
+    int queueDepth = 4;       // Capacidade de cada fila entre etapas
+    int maskWorkers = 2;      // Número de threads da etapa de cor/máscara
+};
+
+// Resultado do processamento de um vídeo
+struct VideoResult {
+    std::string path;
+    bool ok = false;
+    std::string error;          // Motivo da falha (quando ok é false)
+    long frames = 0;
+    double seconds = 0.0;
+    long dumpsWritten = 0;
+    long dumpsDropped = 0;
+    std::set<std::string> uniqueResistors;  // Valores distintos
+    std::vector<std::string> resistors;     // Valor de cada resistência física (por ordem de aparecimento)
+    std::vector<LabelColor> labelsColors;
+};
+
+VideoResult processVideo(cv::VideoCapture& cap, const ProcessOptions& options = ProcessOptions());
+VideoResult processVideo(RawFrameReader& reader, const ProcessOptions& options = ProcessOptions());
+void displayVideoResult(const VideoResult& result);
+bool checkExpectedResistors(const VideoResult& result);
+bool isRawVideoFile(const std::string& path);
+std::vector<VideoResult> processBatch(const std::vector<std::string>& inputs, unsigned threads = 0, const DumpOptions& dumps = DumpOptions());
+void displayBatchResults(const std::vector<VideoResult>& results);
 
 #endif //VIDEO_PROCESSOR_H
@@ -0,0 +1,48 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Conjunto de threads com uma fila de tarefas por thread: cada thread executa as suas
+// tarefas (da mais recente para a mais antiga) e, sem nenhuma, rouba a mais antiga de outra
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+    unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+private:
+    struct Worker {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    bool popLocal(size_t index, std::function<void()>& task);
+    bool steal(size_t thief, std::function<void()>& task);
+    void run(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_{0};   // Tarefas nas filas
+    std::atomic<size_t> pending_{0};  // Tarefas submetidas e ainda não terminadas
+    std::atomic<size_t> next_{0};     // Fila que recebe a próxima tarefa submetida
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    std::condition_variable work_;    // Há tarefas (ou é para terminar)
+    std::condition_variable done_;    // Todas as tarefas terminaram
+};
+
+#endif //WORK_STEALING_POOL_H
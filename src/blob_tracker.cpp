@@ -0,0 +1,137 @@
+#include "blob_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/**
+ * @brief Função para registar o valor obtido numa identificação das cores
+ *
+ * @param value valor da resistência
+ * @param colors cores encontradas
+ * @param confirmVotes votos necessários para confirmar um valor
+ * @param maxAttempts identificações tentadas antes de desistir
+ */
+void Track::vote(const std::string& value, const LabelColor& colors, int confirmVotes, int maxAttempts) {
+    attempts++;
+    const int count = ++votes[value];
+
+    if (resistorValue.empty() || count > votes[resistorValue]) {
+        resistorValue = value;
+        labelColor = colors;
+    }
+    if (count >= confirmVotes) confirmed = true;
+    else if (attempts >= maxAttempts) confirmed = true; // Fica o valor mais votado
+}
+
+
+/**
+ * @brief Função para registar uma identificação das cores sem resultado
+ *
+ * @param maxAttempts identificações tentadas antes de desistir
+ */
+void Track::fail(int maxAttempts) {
+    if (++attempts < maxAttempts) return;
+
+    if (resistorValue.empty()) rejected = true;
+    else confirmed = true;
+}
+
+
+/**
+ * @brief Função para calcular a sobreposição (intersecção / união) das caixas de dois blobs
+ *
+ * @param a blob
+ * @param b blob
+ * @return double
+ */
+static double boxIoU(const OVC& a, const OVC& b) {
+    const int w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    const int h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    if (w <= 0 || h <= 0) return 0.0;
+
+    const double inter = static_cast<double>(w) * h;
+    return inter / (static_cast<double>(a.width) * a.height + static_cast<double>(b.width) * b.height - inter);
+}
+
+
+/**
+ * @brief Função para associar os blobs de um frame às resistências seguidas
+ *
+ * Os pares (resistência, blob) são escolhidos por ordem decrescente de IoU; os que não têm
+ * sobreposição suficiente podem ainda ser associados se o centro de massa do blob estiver a
+ * menos de meia caixa do da resistência. Os blobs que sobram dão novas resistências e as
+ * resistências não vistas durante mais de maxMissed frames são descartadas.
+ *
+ * @param blobs blobs do frame
+ * @return std::vector<Track*> (pela ordem dos blobs)
+ */
+std::vector<Track*> BlobTracker::update(const std::vector<OVC>& blobs) {
+    struct Pair {
+        double score;
+        size_t track, blob;
+    };
+    std::vector<Pair> pairs;
+
+    for (size_t t = 0; t < tracks_.size(); t++) {
+        const OVC& last = tracks_[t].blob;
+
+        for (size_t b = 0; b < blobs.size(); b++) {
+            const double iou = boxIoU(last, blobs[b]);
+            if (iou >= minIoU_) {
+                pairs.push_back({ 1.0 + iou, t, b }); // Pares por IoU antes dos pares por distância
+                continue;
+            }
+
+            const double distance = std::hypot(last.xc - blobs[b].xc, last.yc - blobs[b].yc);
+            const double radius = 0.5 * std::max(last.width, last.height);
+            if (distance < radius) pairs.push_back({ 1.0 - distance / radius, t, b });
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.score > b.score; });
+
+    std::vector<int> blobTrack(blobs.size(), -1);
+    std::vector<bool> trackSeen(tracks_.size(), false);
+
+    for (const auto& pair : pairs) {
+        if (trackSeen[pair.track] || blobTrack[pair.blob] >= 0) continue;
+
+        trackSeen[pair.track] = true;
+        blobTrack[pair.blob] = static_cast<int>(pair.track);
+    }
+
+    // Resistências não vistas: mantidas durante maxMissed frames (o blob pode falhar num frame)
+    std::vector<Track> kept;
+    std::vector<int> remap(tracks_.size(), -1);
+    kept.reserve(tracks_.size() + blobs.size());
+
+    for (size_t t = 0; t < tracks_.size(); t++) {
+        Track& track = tracks_[t];
+        track.missed = trackSeen[t] ? 0 : track.missed + 1;
+        if (track.missed > maxMissed_) continue;
+
+        remap[t] = static_cast<int>(kept.size());
+        kept.push_back(std::move(track));
+    }
+
+    // Blobs sem resistência: novas resistências
+    for (size_t b = 0; b < blobs.size(); b++) {
+        if (blobTrack[b] >= 0) {
+            blobTrack[b] = remap[blobTrack[b]];
+            continue;
+        }
+
+        Track track;
+        track.id = nextId_++;
+        blobTrack[b] = static_cast<int>(kept.size());
+        kept.push_back(std::move(track));
+    }
+    tracks_.swap(kept);
+
+    std::vector<Track*> matched(blobs.size());
+    for (size_t b = 0; b < blobs.size(); b++) {
+        matched[b] = &tracks_[blobTrack[b]];
+        matched[b]->blob = blobs[b];
+    }
+    return matched;
+}
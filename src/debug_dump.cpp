@@ -0,0 +1,103 @@
+#include "debug_dump.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+/**
+ * @brief Construtor: reserva os buffers e inicia a thread de escrita (apenas se ativo)
+ *
+ * @param options opções das imagens de depuração
+ * @param width largura das máscaras
+ * @param height altura das máscaras
+ */
+DebugDump::DebugDump(const DumpOptions& options, int width, int height)
+    : options_(options),
+      items_(options.enabled() ? static_cast<size_t>(std::max(options.maxPending, 1)) : 0),
+      pending_(items_.size() + 1),
+      free_(items_.size() + 1) {
+    if (!enabled()) return;
+
+    for (auto& item : items_) {
+        item.image = vc_bitimage_new(width, height);
+        if (item.image != nullptr) free_.push(&item);
+    }
+    writer_ = std::thread(&DebugDump::run, this);
+}
+
+
+/**
+ * @brief Destrutor: termina a escrita e liberta os buffers
+ */
+DebugDump::~DebugDump() {
+    finish();
+
+    for (auto& item : items_) vc_bitimage_free(item.image);
+}
+
+
+/**
+ * @brief Função para escrever as imagens pendentes e terminar a thread de escrita
+ */
+void DebugDump::finish() {
+    if (writer_.joinable()) {
+        pending_.push(nullptr);
+        writer_.join();
+    }
+}
+
+
+/**
+ * @brief Função para decidir se um frame é guardado
+ *
+ * @param frame índice do frame
+ * @param failed houve blobs em que a identificação falhou
+ * @return bool
+ */
+bool DebugDump::wants(long frame, bool failed) const {
+    return (options_.every > 0 && frame % options_.every == 0) || (options_.onFailure && failed);
+}
+
+
+/**
+ * @brief Função para pedir a escrita de uma máscara (copia-a; não espera pelo disco)
+ *
+ * @param name nome da máscara (literal: não é copiado)
+ * @param frame índice do frame
+ * @param image máscara
+ * @return bool (false = descartada por não haver buffers livres)
+ */
+bool DebugDump::dump(const char* name, long frame, const BVC* image) {
+    Item* item = nullptr;
+
+    if (!enabled() || !free_.tryPop(item)) {
+        dropped_++;
+        return false;
+    }
+    if (!vc_bitimage_copy(image, item->image)) {
+        free_.push(item);
+        dropped_++;
+        return false;
+    }
+
+    item->name = name;
+    item->frame = frame;
+    pending_.push(item);
+    return true;
+}
+
+
+/**
+ * @brief Ciclo da thread de escrita
+ */
+void DebugDump::run() {
+    while (Item* item = pending_.pop()) {
+        char filename[32];
+        std::snprintf(filename, sizeof(filename), "_%06ld.pbm", item->frame);
+
+        const std::string path = options_.directory + "/" + options_.prefix + item->name + filename;
+        if (vc_bitimage_write_pbm(path.c_str(), item->image)) written_++;
+
+        free_.push(item);
+    }
+}
@@ -18,6 +18,60 @@ Color colors[] = {
 // 	{"White",  0,	 360,	0,	 0,   90, 100}
 };
 
+/**
+ * @brief Função para compilar a tabela de cores numa tabela de segmentação HSV
+ *
+ * O intervalo da entrada i de colors[] fica no bit i da tabela.
+ *
+ * @return SVC
+ */
+static SVC buildColorsLut() {
+    SVC lut;
+    vc_hsv_lut_init(&lut);
+
+    for (const auto& core : colors) {
+        vc_hsv_lut_add(&lut, core.hMin, core.hMax, core.sMin, core.sMax, core.vMin, core.vMax);
+    }
+    return lut;
+}
+
+
+/**
+ * @brief Função para obter uma IVC que partilha os dados de uma cv::Mat (sem cópia)
+ *
+ * A IVC respeita o step da cv::Mat (que pode ser uma ROI) e só é válida enquanto
+ * a cv::Mat existir sem ser realocada. Não deve ser libertada com vc_image_free().
+ *
+ * @param mat imagem OpenCV de 8 bits (1 ou 3 canais)
+ * @return IVC vista sobre os dados da cv::Mat (data a nullptr se o formato não for suportado)
+ */
+IVC matToIVC(const cv::Mat& mat) {
+    IVC image{};
+
+    if (mat.empty() || mat.depth() != CV_8U || (mat.channels() != 1 && mat.channels() != 3)) return image;
+
+    image.data = mat.data;
+    image.width = mat.cols;
+    image.height = mat.rows;
+    image.channels = mat.channels();
+    image.levels = 255;
+    image.bytesperline = static_cast<int>(mat.step);
+    image.owndata = 0;
+    return image;
+}
+
+
+/**
+ * @brief Função para obter um cabeçalho cv::Mat sobre os dados de uma IVC (sem cópia)
+ *
+ * @param image imagem IVC
+ * @return cv::Mat que partilha os dados e o bytesperline da IVC
+ */
+cv::Mat ivcToMat(const IVC& image) {
+    return cv::Mat(image.height, image.width, CV_8UC(image.channels), image.data, static_cast<size_t>(image.bytesperline));
+}
+
+
 /**
  * @brief Função para identificar as cores presentes nas blobs
  *
@@ -25,36 +79,19 @@ Color colors[] = {
  * @param foundColors vetor de cores encontradas
  */
 void identifyBlobsColors(IVC* hsvCropImg, std::vector<std::pair<int, std::string>>& foundColors) {
+    static const SVC colorsLut = buildColorsLut();
     const int totalPixels = hsvCropImg->width * hsvCropImg->height;
     constexpr int blueCounter = 0;
+    int firstX[VC_HSV_LUT_MAX];
 
-    for (auto & core : colors) {
-        // Cria uma nova imagem para segmentar
-        IVC* segmentedCropImg = vc_image_new(hsvCropImg->width, hsvCropImg->height, 3, hsvCropImg->levels);
-
-        // Segmentação HSV
-        vc_hsv_segmentation(hsvCropImg, segmentedCropImg, core.hMin, core.hMax, core.sMin, core.sMax, core.vMin, core.vMax);
-
-        // Guarda a imagem segmentada
-        char filename[50];
-        vc_write_image(filename, segmentedCropImg);
-
-        bool isColorPresent = false;
-
-        // Verifica se a cor está presente na imagem segmentada
-        for (int y = 0; y < segmentedCropImg->height; y++) {
-            for (int x = 0; x < segmentedCropImg->width; x++) {
-                const int pos = y * segmentedCropImg->bytesperline + x * segmentedCropImg->channels;
-                if (segmentedCropImg->data[pos] == 255) {
-                    foundColors.emplace_back( x, core.name );
-                    isColorPresent = true;
-                    break;
-                }
-            }
-            if (isColorPresent) break;
-        }
+    // Classifica todos os pixeis do recorte por todas as cores numa só passagem
+    vc_hsv_lut_classify(hsvCropImg, nullptr, &colorsLut, firstX);
 
-        vc_image_free(segmentedCropImg);
+    // Guarda a posição x do primeiro pixel de cada cor presente
+    for (int i = 0; i < colorsLut.nranges; i++) {
+        if (firstX[i] >= 0) {
+            foundColors.emplace_back(firstX[i], colors[i].name);
+        }
     }
 
     // Se +50% dos pixels são azuis, ignora o blob
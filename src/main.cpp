@@ -1,21 +1,96 @@
 #include "video_processor.h"
+#include "image_processing.h"
 #include "utility.h"
 
-int main() {
-	cv::VideoCapture cap(videoPath);
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 
-	// Verificar se o vídeo foi aberto corretamente
-	if (!cap.isOpened()) {
-		std::cerr << "Erro ao abrir o vídeo." << std::endl;
-		return -1;
+int main(int argc, char** argv) {
+	// Argumentos: [--batch] [--threads N] [--dump-every N] [--dump-failures] [--dump-dir pasta]
+	//             [--raw LxA] [--y4m] [--fps F] [vídeos e/ou pastas; "-" = stdin]
+	std::vector<std::string> inputs;
+	DumpOptions dumps;
+	unsigned threads = 0;
+	bool batch = false;
+	bool y4m = false;
+	int rawWidth = 0, rawHeight = 0;
+	double frameRate = 0.0;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--batch") == 0) batch = true;
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--dump-every") == 0 && i + 1 < argc) dumps.every = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--dump-failures") == 0) dumps.onFailure = true;
+		else if (std::strcmp(argv[i], "--dump-dir") == 0 && i + 1 < argc) dumps.directory = argv[++i];
+		else if (std::strcmp(argv[i], "--raw") == 0 && i + 1 < argc) std::sscanf(argv[++i], "%dx%d", &rawWidth, &rawHeight);
+		else if (std::strcmp(argv[i], "--y4m") == 0) y4m = true;
+		else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) frameRate = std::atof(argv[++i]);
+		else inputs.push_back(argv[i]);
+	}
+	if (inputs.empty()) inputs.push_back(videoPath);
+
+	// Modo sem interface: vários vídeos em simultâneo
+	if (batch) {
+		// Os processadores são ocupados por vídeos em simultâneo: os kernels correm em série
+		vc_set_threads(1);
+
+		const std::vector<VideoResult> results = processBatch(inputs, threads, dumps);
+		displayBatchResults(results);
+
+		for (const auto& result : results) {
+			if (!result.ok) return -1;
+		}
+		return 0;
+	}
+
+	// Os processadores são repartidos pelas threads da etapa de máscara, que correm os kernels em simultâneo
+	ProcessOptions options;
+	options.dumps = dumps;
+	vc_set_threads(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / options.maskWorkers));
+
+	VideoResult result;
+
+	// Frames sem contentor (RGB24 com --raw; Y4M com --y4m, .y4m ou stdin): sem descodificação
+	if (rawWidth > 0 || y4m || isRawVideoFile(inputs.front())) {
+		RawFrameReader reader;
+
+		if (!reader.open(inputs.front(), rawWidth, rawHeight, frameRate)) {
+			std::cerr << "Erro ao abrir a entrada de frames." << std::endl;
+			return -1;
+		}
+
+		VideoInfo info{};
+		info.frameRate = reader.frameRate();
+		info.width = reader.width();
+		info.height = reader.height();
+		displayVideoInfo(info);
+
+		result = processVideo(reader, options);
+	} else {
+		cv::VideoCapture cap(inputs.front());
+
+		// Verificar se o vídeo foi aberto corretamente
+		if (!cap.isOpened()) {
+			std::cerr << "Erro ao abrir o vídeo." << std::endl;
+			return -1;
+		}
+
+		// Obter e exibir informações do vídeo
+		const VideoInfo info = getVideoInfo(cap);
+		displayVideoInfo(info);
+
+		// Processar o vídeo
+		result = processVideo(cap, options);
 	}
+	if (!result.ok) return -1;
 
-	// Obter e exibir informações do vídeo
-	const VideoInfo info = getVideoInfo(cap);
-	displayVideoInfo(info);
+	displayVideoResult(result);
 
-	// Processar o vídeo
-	processVideo(cap);
+	// O vídeo de referência tem resistências conhecidas: confirma a contagem por resistência física
+	if (inputs.front() == videoPath) checkExpectedResistors(result);
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,167 @@
+#include "raw_frame_reader.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#define RAW_READ_BUFFER (4 << 20) // Buffer de leitura (4 MiB): pipes e stdin são lidos em blocos grandes
+
+
+/**
+ * @brief Destrutor: fecha a entrada
+ */
+RawFrameReader::~RawFrameReader() {
+    close();
+}
+
+
+/**
+ * @brief Função para abrir uma entrada de frames
+ *
+ * Com width e height, a entrada é RGB24 em bruto (width * height * 3 bytes por frame);
+ * sem eles, é Y4M e as dimensões vêm do cabeçalho.
+ *
+ * @param path ficheiro ou pipe ("-" = stdin)
+ * @param width largura (RGB24)
+ * @param height altura (RGB24)
+ * @param frameRate frames por segundo (RGB24; no Y4M sobrepõe-se ao do cabeçalho se > 0)
+ * @return bool
+ */
+bool RawFrameReader::open(const std::string& path, int width, int height, double frameRate) {
+    close();
+
+    if (path == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        file_ = stdin;
+    } else {
+        file_ = std::fopen(path.c_str(), "rb");
+    }
+    if (file_ == nullptr) return false;
+
+    std::setvbuf(file_, nullptr, _IOFBF, RAW_READ_BUFFER);
+
+    y4m_ = width <= 0 || height <= 0;
+    if (y4m_) {
+        if (!readY4MHeader()) {
+            std::cerr << "Cabeçalho Y4M inválido ou formato não suportado: " << path << std::endl;
+            close();
+            return false;
+        }
+    } else {
+        format_ = -1;
+        width_ = width;
+        height_ = height;
+        frameBytes_ = static_cast<size_t>(width) * height * 3;
+    }
+
+    if (frameRate > 0.0) frameRate_ = frameRate;
+    if (frameRate_ <= 0.0) frameRate_ = 30.0;
+    return true;
+}
+
+
+/**
+ * @brief Função para ler o cabeçalho Y4M (YUV4MPEG2 W<l> H<a> F<n>:<d> C<croma> ...)
+ *
+ * @return bool
+ */
+bool RawFrameReader::readY4MHeader() {
+    char line[256];
+    if (std::fgets(line, sizeof(line), file_) == nullptr || std::strncmp(line, "YUV4MPEG2 ", 10) != 0) return false;
+
+    std::istringstream tokens(line + 10);
+    std::string token;
+    std::string chroma = "420jpeg";
+
+    while (tokens >> token) {
+        const std::string value = token.substr(1);
+
+        switch (token[0]) {
+            case 'W': width_ = std::atoi(value.c_str()); break;
+            case 'H': height_ = std::atoi(value.c_str()); break;
+            case 'C': chroma = value; break;
+            case 'F': {
+                const double num = std::atof(value.c_str());
+                const size_t colon = value.find(':');
+                const double den = colon == std::string::npos ? 1.0 : std::atof(value.c_str() + colon + 1);
+                if (num > 0.0 && den > 0.0) frameRate_ = num / den;
+                break;
+            }
+            case 'X':
+                if (value == "COLORRANGE=FULL") fullRange_ = 1;
+                break;
+            default: break;
+        }
+    }
+
+    if (width_ <= 0 || height_ <= 0) return false;
+
+    const size_t luma = static_cast<size_t>(width_) * height_;
+    // Só amostras de 8 bits: C420p10, C444p12, etc. têm 2 bytes por amostra e são rejeitados
+    if (chroma == "420" || chroma == "420jpeg" || chroma == "420mpeg2" || chroma == "420paldv") {
+        format_ = VC_YUV_420;
+        frameBytes_ = luma + 2 * static_cast<size_t>((width_ + 1) / 2) * ((height_ + 1) / 2);
+    } else if (chroma == "444") {
+        format_ = VC_YUV_444;
+        frameBytes_ = luma * 3;
+    } else if (chroma == "mono") {
+        format_ = VC_YUV_MONO;
+        frameBytes_ = luma;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * @brief Função para ler o próximo frame (frameBytes() bytes: RGB24 ou os planos YUV)
+ *
+ * @param dst destino
+ * @return bool (false no fim da entrada)
+ */
+bool RawFrameReader::read(unsigned char* dst) {
+    if (file_ == nullptr) return false;
+
+    // No Y4M, cada frame começa por uma linha FRAME[ parâmetros]
+    if (y4m_) {
+        char marker[5];
+        if (std::fread(marker, 1, sizeof(marker), file_) != sizeof(marker) || std::memcmp(marker, "FRAME", 5) != 0) return false;
+
+        int c;
+        while ((c = std::fgetc(file_)) != '\n' && c != EOF) {}
+        if (c == EOF) return false;
+    }
+
+    return std::fread(dst, 1, frameBytes_, file_) == frameBytes_;
+}
+
+
+/**
+ * @brief Função para converter um frame lido para RGB (apenas Y4M)
+ *
+ * @param src frame lido
+ * @param dst imagem RGB
+ * @return int
+ */
+int RawFrameReader::toRGB(const unsigned char* src, const IVC* dst) const {
+    if (isRGB()) return 0;
+    return vc_yuv_to_rgb(src, format_, fullRange_, dst);
+}
+
+
+/**
+ * @brief Função para fechar a entrada (stdin não é fechado)
+ */
+void RawFrameReader::close() {
+    if (file_ != nullptr && file_ != stdin) std::fclose(file_);
+    file_ = nullptr;
+}
@@ -4,12 +4,124 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
 #include "vc.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// Extensoes SIMD disponiveis no compilador (AVX2 requer VC_ENABLE_AVX2 no CMake)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VC_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define VC_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+// Operacoes atomicas da etiquetagem paralela no MSVC (_InterlockedCompareExchange)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Ficheiros projetados em memoria (vc_image_map); sem mmap sao lidos / escritos de uma vez
+#if defined(__unix__) || defined(__APPLE__)
+#define VC_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Os kernels dividem as linhas por threads com OpenMP; sem ele correm em serie
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Diretivas OpenMP dos kernels; sem OpenMP desaparecem e o numero de threads (nt) fica por usar
+#if defined(_OPENMP) && defined(_MSC_VER)
+#define VC_OMP(directive) __pragma(omp directive)
+#elif defined(_OPENMP)
+#define VC_OMP_PRAGMA(text) _Pragma(#text)
+#define VC_OMP(directive) VC_OMP_PRAGMA(omp directive)
+#else
+#define VC_OMP(directive)
+#endif
+#ifdef _OPENMP
+#define VC_OMP_PARALLEL_FOR(nt) VC_OMP(parallel for schedule(static) num_threads(nt) if (nt > 1))
+#define VC_OMP_PARALLEL_FOR_DYNAMIC(nt) VC_OMP(parallel for schedule(dynamic) num_threads(nt) if (nt > 1))
+#define VC_OMP_PARALLEL(nt) VC_OMP(parallel num_threads(nt) if (nt > 1))
+#else
+#define VC_OMP_PARALLEL_FOR(nt) (void)(nt);
+#define VC_OMP_PARALLEL_FOR_DYNAMIC(nt) (void)(nt);
+#define VC_OMP_PARALLEL(nt) (void)(nt);
+#endif
+
+#define VC_PARALLEL_MIN (256 * 256) // Numero minimo de pixeis para dividir um kernel por threads
+
+static int vc_nthreads = 0; // Threads dos kernels (0 = uma por processador)
+
+
+/**
+ * @brief Define o numero de threads usadas pelos kernels
+ *
+ * @param nthreads Numero de threads (1 = execucao em serie; 0 = uma por processador)
+ * @return int
+ */
+int vc_set_threads(const int nthreads)
+{
+    if (nthreads < 0) return 0;
+
+    vc_nthreads = nthreads;
+    return 1;
+}
+
+
+/**
+ * @brief Numero de threads usadas pelos kernels (1 sem OpenMP)
+ *
+ * @return int
+ */
+int vc_get_threads(void)
+{
+#ifdef _OPENMP
+    return vc_nthreads > 0 ? vc_nthreads : omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+
+/**
+ * @brief Numero de threads para um kernel sobre uma imagem (1 se for pequena demais para compensar)
+ *
+ * @param width Largura
+ * @param height Altura
+ * @return int
+ */
+static int vc_kernel_threads(const int width, const int height)
+{
+    return (long)width * height >= VC_PARALLEL_MIN ? MIN(vc_get_threads(), MAX(height, 1)) : 1;
+}
+
+
+/**
+ * @brief Indice da thread atual dentro de uma regiao paralela (0 em serie)
+ *
+ * @return int
+ */
+static int vc_thread_index(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
 
 /**
  * @brief Alocar memoria para uma imagem
@@ -32,6 +144,7 @@ IVC* vc_image_new(const int width, const int height, const int channels, const i
     image->channels = channels;
     image->levels = levels;
     image->bytesperline = image->width * image->channels;
+    image->owndata = 1;
     image->data = (unsigned char*)malloc(image->width * image->height * image->channels * sizeof(char));
 
     if (image->data == NULL) return vc_image_free(image);
@@ -50,7 +163,8 @@ IVC* vc_image_free(IVC* image)
 {
     if (image != NULL)
     {
-        if (image->data != NULL)
+        // Uma vista nao e dona dos pixeis: a memoria pertence a imagem-mae
+        if (image->data != NULL && image->owndata)
         {
             free(image->data);
             image->data = NULL;
@@ -65,1724 +179,4908 @@ IVC* vc_image_free(IVC* image)
 
 
 /**
- * @brief Conversao de RGB para HSV
+ * @brief Cria uma vista (regiao de interesse) sobre outra imagem, sem copiar pixeis
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
+ * A vista partilha os dados e o bytesperline da imagem-mae, pelo que continua valida
+ * enquanto a mae existir. Pode ser declarada na stack e nao precisa de ser libertada.
+ *
+ * @param view Vista a preencher
+ * @param parent Imagem-mae
+ * @param x Coluna do canto superior esquerdo
+ * @param y Linha do canto superior esquerdo
+ * @param width Largura da vista
+ * @param height Altura da vista
  * @return int
  */
-int vc_rgb_to_hsv(const IVC* src, const IVC* dst) {
-    const unsigned char * data_src = src->data;
-    unsigned char* data_dst = dst->data;
-    const int width_src = src->width;
-    const int width_dst = dst->width;
-    const int height_src = src->height;
-    const int height_dst = dst->height;
-    const int channels_src = src->channels;
-    const int channel_dst = dst->channels;
-    int bytesperline_src = width_src * channels_src, bytesperline_dst = width_dst * channel_dst;
-
-    if (width_src <= 0 || height_src <= 0 || data_src == NULL) return 0;
-    if (channels_src != 3 || channel_dst != 3) return 0;
-    if (width_src != width_dst || height_src != height_dst) return 0;
+int vc_image_view(IVC* view, const IVC* parent, const int x, const int y, const int width, const int height)
+{
+    if (view == NULL || parent == NULL || parent->data == NULL) return 0;
+    if (x < 0 || y < 0 || width <= 0 || height <= 0) return 0;
+    if (x + width > parent->width || y + height > parent->height) return 0;
+
+    view->data = parent->data + (size_t)y * parent->bytesperline + (size_t)x * parent->channels;
+    view->width = width;
+    view->height = height;
+    view->channels = parent->channels;
+    view->levels = parent->levels;
+    view->bytesperline = parent->bytesperline;
+    view->owndata = 0;
 
-    for (int y = 0; y < height_src; y++) {
-        for (int x = 0; x < width_src; x++) {
-            const int pos_src = y * bytesperline_src + x * channels_src;
-            const int pos_dst = y * bytesperline_dst + x * channel_dst;
-            const float rf = data_src[pos_src];
-            const float gf = data_src[pos_src + 1];
-            const float bf = data_src[pos_src + 2];
-            const float min = MINRGB(rf, gf, bf);
-            const float max = MAXRGB(rf, gf, bf);
-            float hue = 0;
-            float sat = 0;
-
-            if (max > 0) {
-                sat = (max - min) / max * 255;
-
-                if (sat > 0) {
-                    if (max == rf) {
-                        if (gf >= bf) {
-                            hue = 60 * (gf - bf) / (max - min);
-                        } else {
-                            hue = 360 + 60 * (gf - bf) / (max - min);
-                        }
-                    } else if (max == gf) {
-                        hue = 120 + 60 * (bf - rf) / (max - min);
-                    } else if (max == bf) {
-                        hue = 240 + 60 * (rf - gf) / (max - min);
-                    }
-                    hue = hue / 360 * 255;
-                }
-            }
-            data_dst[pos_dst] = hue;
-            data_dst[pos_dst + 1] = sat;
-            data_dst[pos_dst + 2] = max;
-        }
-    }
     return 1;
 }
 
 
+#define VC_ARENA_ALIGN 16 // Alinhamento de cada alocacao da arena (suficiente para SSE)
+
+
 /**
- * @brief Segmentacao de uma imagem em HSV
+ * @brief Alocar uma arena de memoria temporaria
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @param hMin Valor minimo de matiz - [0, 360]
- * @param hMax Valor maximo de matiz - [0, 360]
- * @param sMin Valor minimo de saturação - [0, 100]
- * @param sMax Valor maximo de saturação - [0, 100]
- * @param vMin Valor minimo de valor - [0, 100]
- * @param vMax Valor maximo de valor - [0, 100]
- * @return int
+ * @param size Capacidade inicial (bytes); cresce sozinha se for ultrapassada
+ * @return AVC*
  */
-int vc_hsv_segmentation(const IVC* src, const IVC* dst, int hMin, int hMax, int sMin, int sMax, int vMin, int vMax)
+AVC* vc_arena_new(const size_t size)
 {
-    const unsigned char* data = src->data;
-    unsigned char* dstdata = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    src->bytesperline;
-    const int channels = src->channels;
+    AVC* arena = malloc(sizeof(AVC));
+    if (arena == NULL) return NULL;
+
+    arena->data = size > 0 ? malloc(size) : NULL;
+    arena->size = arena->data != NULL ? size : 0;
+    arena->used = 0;
+    arena->overflow = 0;
+    arena->extra = NULL;
+    return arena;
+}
 
-    // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL)
-        return 0;
-    if (channels != 3)
-        return 0;
 
-    const int size = width * height * channels;
+/**
+ * @brief Liberta os blocos alocados fora da arena
+ *
+ * @param arena Arena
+ */
+static void vc_arena_free_extra(AVC* arena)
+{
+    void* block = arena->extra;
 
-    for (int i = 0; i < size; i = i + channels)
-    {
-        const int h = (float)data[i] / 255.0f * 360.0f;
-        const int s = (float)data[i + 1] / 255.0f * 100.0f;
-        const int v = (float)data[i + 2] / 255.0f * 100.0f;
-
-        if (h > hMin && h <= hMax && s >= sMin && s <= sMax && v >= vMin && v <= vMax) {
-            dstdata[i] = 255;
-            dstdata[i + 1] = 255;
-            dstdata[i + 2] = 255;
-        } else {
-            dstdata[i] = 0;
-            dstdata[i + 1] = 0;
-            dstdata[i + 2] = 0;
-        }
+    while (block != NULL) {
+        void* next = *(void**)block;
+        free(block);
+        block = next;
     }
-    return 1;
+    arena->extra = NULL;
 }
 
 
 /**
- * @brief Conversao de RGB para escala de cinza
+ * @brief Libertar uma arena (e tudo o que foi alocado nela)
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @return int
+ * @param arena Arena
+ * @return AVC* NULL
  */
-int vc_rgb_to_gray(const IVC* src, const IVC* dst)
+AVC* vc_arena_free(AVC* arena)
 {
-    unsigned char* datasrc = src->data;
-    int bytesperline_src = src->bytesperline;
-    const int channels_src = src->channels;
-    unsigned char* datadst = dst->data;
-    int bytesperline_dst = dst->bytesperline;
-    const int channels_dst = dst->channels;
-    const int width = src->width;
-    const int height = src->height;
-
-    //verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL)
-        return 0;
-    if (src->width != dst->width || src->height != dst->height)
-        return 0;
-    if (src->channels != 3 || dst->channels != 1)
-        return 0;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos_src = y * bytesperline_src + x * channels_src;
-            const long int pos_dst = y * bytesperline_dst + x * channels_dst;
-            const float rf = datasrc[pos_src];
-            const float gf = datasrc[pos_src + 1];
-            const float bf = datasrc[pos_src + 2];
-
-            datadst[pos_dst] = (unsigned char)(rf * 0.299 + gf * 0.587 + bf * 0.114);
-        }
+    if (arena != NULL) {
+        vc_arena_free_extra(arena);
+        free(arena->data);
+        free(arena);
     }
-    return 1;
+    return NULL;
 }
 
 
 /**
- * @brief Conversao de escala de cinza para binario
+ * @brief Reserva memoria na arena
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @param kernel Tamanho do kernel
- * @return int
+ * Se a arena estiver cheia o pedido e servido por um bloco a parte, e o proximo
+ * vc_arena_reset() aumenta a arena para que a mesma carga ja caiba nela.
+ *
+ * @param arena Arena
+ * @param size Numero de bytes
+ * @return void* Memoria alinhada a VC_ARENA_ALIGN (NULL em erro)
  */
-int vc_gray_to_binary_midpoint(const IVC* src, const IVC* dst, const int kernel)
+void* vc_arena_alloc(AVC* arena, size_t size)
 {
-    unsigned char* datasrc = src->data;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
-    const int offset = (kernel - 1) / 2;
+    if (arena == NULL) return NULL;
 
-    // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL)
-        return 0;
-    if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels)
-        return 0;
-    if (channels != 1)
-        return 0;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = y * bytesperline + x * channels;
-            int max = 0;
-            int min = 255;
-
-            // NxM Vizinhos
-            for (int ky = -offset; ky <= offset; ky++) {
-                for (int kx = -offset; kx <= offset; kx++) {
-                    if (y + ky >= 0 && y + ky < height && x + kx >= 0 && x + kx < width) {
-                        long int posk = (y + ky) * bytesperline + (x + kx) * channels;
-
-                        // Calculo do minimo e do maximo a estudar na vizinhanca
-                        if (datasrc[posk] > max)
-                            max = datasrc[posk];
-                        if (datasrc[posk] < min)
-                            min = datasrc[posk];
-                    }
-                }
-            }
-            //Calculo do midpoint
-            const unsigned char threshold = (unsigned char)((float)(max + min) / (float)2);
+    size = (size + VC_ARENA_ALIGN - 1) & ~(size_t)(VC_ARENA_ALIGN - 1);
 
-            if (datasrc[pos] > threshold) {
-                datadst[pos] = 255;
-            } else {
-                datadst[pos] = 0;
-            }
-        }
+    if (arena->size - arena->used >= size) {
+        void* p = arena->data + arena->used;
+        arena->used += size;
+        return p;
     }
-    return 1;
+
+    // O inicio do bloco guarda o ponteiro para o bloco seguinte
+    unsigned char* block = malloc(VC_ARENA_ALIGN + size);
+    if (block == NULL) return NULL;
+
+    *(void**)block = arena->extra;
+    arena->extra = block;
+    arena->overflow += size;
+    return block + VC_ARENA_ALIGN;
 }
 
 
 /**
- * @brief Filtro de media passa-baixa em escala de cinza
+ * @brief Liberta de uma so vez tudo o que foi alocado na arena
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @return int
+ * @param arena Arena
  */
-int vc_gray_lowpass_mean_filter(const IVC* src, const IVC* dst)
+void vc_arena_reset(AVC* arena)
 {
-    unsigned char* datasrc = src->data;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
-
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            const long int posA = (y - 1) * bytesperline + (x - 1) * channels;
-            const long int posB = (y - 1) * bytesperline + x * channels;
-            const long int posC = (y - 1) * bytesperline + (x + 1) * channels;
-            const long int posD = y * bytesperline + (x - 1) * channels;
-            const long int posX = y * bytesperline + x * channels;
-            const long int posE = y * bytesperline + (x + 1) * channels;
-            const long int posF = (y + 1) * bytesperline + (x - 1) * channels;
-            const long int posG = (y + 1) * bytesperline + x * channels;
-            const long int posH = (y + 1) * bytesperline + (x + 1) * channels;
+    if (arena == NULL) return;
 
-            int sum = datasrc[posA] * +1;
-            sum += datasrc[posB] * +1;
-            sum += datasrc[posC] * +1;
-            sum += datasrc[posD] * +1;
-            sum += datasrc[posX] * +1;
-            sum += datasrc[posE] * +1;
-            sum += datasrc[posF] * +1;
-            sum += datasrc[posG] * +1;
-            sum += datasrc[posH] * +1;
+    // Houve blocos a parte: passa a arena para a capacidade que teria sido necessaria
+    if (arena->extra != NULL) {
+        const size_t size = arena->size + arena->overflow;
 
-            datadst[posX] = (unsigned char)(sum / 9);
-        }
+        vc_arena_free_extra(arena);
+        free(arena->data);
+        arena->data = malloc(size);
+        arena->size = arena->data != NULL ? size : 0;
     }
-    return 1;
+    arena->used = 0;
+    arena->overflow = 0;
 }
 
 
 /**
- * @brief Erosao binaria em escala de cinza
+ * @brief Memoria de trabalho de uma funcao: da arena, se existir, ou do heap
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @param kernel Tamanho do kernel
- * @return int
+ * @param arena Arena (ou NULL)
+ * @param size Numero de bytes
+ * @return void*
  */
-int vc_binary_erode(const IVC* src, const IVC* dst, int kernel)
+static void* vc_scratch_alloc(AVC* arena, const size_t size)
 {
-    unsigned char* datasrc = src->data;
-    int bytesperline_src = src->width * src->channels;
-    const int channels_src = src->channels;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    const int bytesperline_dst = dst->width * dst->channels;
-    const int channels_dst = dst->channels;
-    kernel *= 0.5;
+    return arena != NULL ? vc_arena_alloc(arena, size) : malloc(size);
+}
 
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
-    if (src->width != dst->width || src->height != dst->height) return 0;
-    if (src->channels != 1 || dst->channels != 1) return 0;
 
-    for (int y = kernel; y < height - kernel; y++) {
-        for (int x = kernel; x < width - kernel; x++) {
-            const long int pos_dst = y * bytesperline_dst + x * channels_dst;
-            int verifica = 0;
+/**
+ * @brief Liberta memoria obtida com vc_scratch_alloc() (na arena, nao faz nada)
+ *
+ * @param arena Arena (ou NULL)
+ * @param p Memoria
+ */
+static void vc_scratch_release(AVC* arena, void* p)
+{
+    if (arena == NULL) free(p);
+}
 
-            for (int y2 = y - kernel; y2 <= y + kernel; y2++) {
-                for (int x2 = x - kernel; x2 <= x + kernel; x2++) {
-                    const long int pos_src = y2 * bytesperline_src + x2 * channels_src;
 
-                    if (datasrc[pos_src] == 0) {
-                        verifica = 1;
-                    }
-                }
-            }
+/**
+ * @brief Alocar um conjunto de imagens reutilizaveis
+ *
+ * @return PVC*
+ */
+PVC* vc_pool_new(void)
+{
+    return calloc(1, sizeof(PVC));
+}
 
-            if (verifica == 1) {
-                datadst[pos_dst] = 0;
-            } else {
-                datadst[pos_dst] = 255;
-            }
-        }
+
+/**
+ * @brief Libertar um conjunto de imagens (incluindo as que ainda estejam emprestadas)
+ *
+ * @param pool Conjunto de imagens
+ * @return PVC* NULL
+ */
+PVC* vc_pool_free(PVC* pool)
+{
+    if (pool != NULL) {
+        for (int i = 0; i < pool->count; i++) vc_image_free(pool->images[i]);
+        free(pool->images);
+        free(pool->capacity);
+        free(pool->inuse);
+        free(pool);
     }
-    return 1;
+    return NULL;
 }
 
 
 /**
- * @brief Etiquetagem de blobs
+ * @brief Empresta uma imagem do conjunto
  *
- * @param src Imagem binaria de entrada
- * @param dst Imagem grayscale (ira conter as etiquetas)
- * @param nlabels Endereco de memoria de uma variavel, onde sera armazenado o numero de etiquetas encontradas.
- * @return OVC*
+ * E escolhida a imagem livre de menor capacidade que chegue. Se nenhuma chegar, a
+ * maior livre e aumentada; so sem imagens livres e que o conjunto cresce. Assim,
+ * depois dos primeiros frames, o numero e o tamanho dos buffers estabilizam e
+ * deixa de haver alocacoes. O conteudo da imagem e indefinido.
+ *
+ * @param pool Conjunto de imagens
+ * @param width Largura
+ * @param height Altura
+ * @param channels Canais
+ * @param levels Niveis
+ * @return IVC* (devolver com vc_pool_release(), nunca com vc_image_free())
  */
-OVC* vc_binary_blob_labelling(const IVC* src, const IVC* dst, int* nlabels)
+IVC* vc_pool_acquire(PVC* pool, const int width, const int height, const int channels, const int levels)
 {
-    unsigned char* datasrc = src->data;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
-    int x, y, a;
-    long int i, size;
-    long int posX;
-    int labeltable[256] = { 0 };
-    int labelarea[256] = { 0 };
-    int label = 1; // Etiqueta inicial.
-    int tmplabel;
-
-    // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL)
-        return 0;
-    if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels)
-        return NULL;
-    if (channels != 1)
-        return NULL;
+    if (pool == NULL || width <= 0 || height <= 0 || channels <= 0 || levels <= 0 || levels > 255) return NULL;
 
-    // Copia dados da imagem binaria para imagem grayscale
-    memcpy(datadst, datasrc, bytesperline * height);
+    const size_t need = (size_t)width * height * channels;
+    int best = -1, largest = -1;
 
-    // Todos os pixeis de plano de fundo devem obrigatoriamente ter valor 0
-    // Todos os pixeis de primeiro plano devem obrigatoriamente ter valor 255
-    // Serao atribuidas etiquetas no intervalo [1,254]
-    // Este algoritmo esta assim limitado a 255 labels
-    for (i = 0, size = bytesperline * height; i < size; i++) {
-        if (datadst[i] != 0) datadst[i] = 255;
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->inuse[i]) continue;
+        if (pool->capacity[i] >= need && (best < 0 || pool->capacity[i] < pool->capacity[best])) best = i;
+        if (largest < 0 || pool->capacity[i] > pool->capacity[largest]) largest = i;
     }
 
-    // Limpa os rebordos da imagem binaria
-    for (y = 0; y < height; y++) {
-        datadst[y * bytesperline + 0 * channels] = 0;
-        datadst[y * bytesperline + (width - 1) * channels] = 0;
-    }
+    if (best < 0 && largest >= 0) {
+        unsigned char* data = realloc(pool->images[largest]->data, need);
+        if (data == NULL) return NULL;
 
-    for (x = 0; x < width; x++) {
-        datadst[0 * bytesperline + x * channels] = 0;
-        datadst[(height - 1) * bytesperline + x * channels] = 0;
+        pool->images[largest]->data = data;
+        pool->capacity[largest] = need;
+        best = largest;
     }
 
-    // Efetua a etiquetagem
-    for (y = 1; y < height - 1; y++) {
-        for (x = 1; x < width - 1; x++) {
-            // Kernel:
-            // A B C
-            // D X
-            const long int posA = (y - 1) * bytesperline + (x - 1) * channels;  // A
-            const long int posB = (y - 1) * bytesperline + x * channels;	    // B
-            const long int posC = (y - 1) * bytesperline + (x + 1) * channels;  // C
-            const long int posD = y * bytesperline + (x - 1) * channels;		// D
-            posX = y * bytesperline + x * channels;				                // X
+    if (best < 0) {
+        if (pool->count == pool->max) {
+            const int max = pool->max > 0 ? 2 * pool->max : 8;
+            IVC** images = realloc(pool->images, max * sizeof(IVC*));
+            if (images != NULL) pool->images = images;
+            size_t* capacity = realloc(pool->capacity, max * sizeof(size_t));
+            if (capacity != NULL) pool->capacity = capacity;
+            int* inuse = realloc(pool->inuse, max * sizeof(int));
+            if (inuse != NULL) pool->inuse = inuse;
+
+            if (images == NULL || capacity == NULL || inuse == NULL) return NULL;
+            pool->max = max;
+        }
 
-            // Se o pixel foi marcado
-            if (datadst[posX] != 0) {
-                if (datadst[posA] == 0 && datadst[posB] == 0 && datadst[posC] == 0 && datadst[posD] == 0) {
-                    datadst[posX] = label;
-                    labeltable[label] = label;
-                    label++;
-                } else {
-                    int num = 255;
-                    // Se A esta marcado
-                    if (datadst[posA] != 0)
-                        num = labeltable[datadst[posA]];
-                    // Se B esta marcado, e o menor que a etiqueta "num"
-                    if (datadst[posB] != 0 && labeltable[datadst[posB]] < num)
-                        num = labeltable[datadst[posB]];
-                    // Se C esta marcado, e o menor que a etiqueta "num"
-                    if (datadst[posC] != 0 && labeltable[datadst[posC]] < num)
-                        num = labeltable[datadst[posC]];
-                    // Se D esta marcado, e o menor que a etiqueta "num"
-                    if (datadst[posD] != 0 && labeltable[datadst[posD]] < num)
-                        num = labeltable[datadst[posD]];
+        IVC* image = vc_image_new(width, height, channels, levels);
+        if (image == NULL) return NULL;
 
-                    // Atribui a etiqueta ao pixel
-                    datadst[posX] = num;
-                    labeltable[num] = num;
+        pool->images[pool->count] = image;
+        pool->capacity[pool->count] = need;
+        best = pool->count++;
+    }
 
-                    // Atualiza a tabela de etiquetas
-                    if (datadst[posA] != 0) {
-                        if (labeltable[datadst[posA]] != num) {
-                            for (tmplabel = labeltable[datadst[posA]], a = 1; a < label; a++) {
-                                if (labeltable[a] == tmplabel) labeltable[a] = num;
-                            }
-                        }
-                    }
+    IVC* image = pool->images[best];
+    image->width = width;
+    image->height = height;
+    image->channels = channels;
+    image->levels = levels;
+    image->bytesperline = width * channels;
+    pool->inuse[best] = 1;
+    return image;
+}
 
-                    if (datadst[posB] != 0) {
-                        if (labeltable[datadst[posB]] != num) {
-                            for (tmplabel = labeltable[datadst[posB]], a = 1; a < label; a++) {
-                                if (labeltable[a] == tmplabel) labeltable[a] = num;
-                            }
-                        }
-                    }
 
-                    if (datadst[posC] != 0) {
-                        if (labeltable[datadst[posC]] != num) {
-                            for (tmplabel = labeltable[datadst[posC]], a = 1; a < label; a++) {
-                                if (labeltable[a] == tmplabel) labeltable[a] = num;
-                            }
-                        }
-                    }
+/**
+ * @brief Devolve ao conjunto uma imagem emprestada por vc_pool_acquire()
+ *
+ * @param pool Conjunto de imagens
+ * @param image Imagem
+ * @return int
+ */
+int vc_pool_release(PVC* pool, IVC* image)
+{
+    if (pool == NULL || image == NULL) return 0;
 
-                    if (datadst[posD] != 0) {
-                        if (labeltable[datadst[posD]] != num) {
-                            for (tmplabel = labeltable[datadst[posC]], a = 1; a < label; a++) {
-                                if (labeltable[a] == tmplabel) labeltable[a] = num;
-                            }
-                        }
-                    }
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->images[i] == image) {
+            pool->inuse[i] = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Conversao de um pixel RGB para HSV (referencia escalar)
+ *
+ * @param r Componente vermelha
+ * @param g Componente verde
+ * @param b Componente azul
+ * @param h Matiz [0, 255]
+ * @param s Saturacao [0, 255]
+ * @param v Valor [0, 255]
+ */
+static void vc_rgb_to_hsv_pixel(const unsigned char r, const unsigned char g, const unsigned char b,
+                                unsigned char* h, unsigned char* s, unsigned char* v)
+{
+    const float rf = r;
+    const float gf = g;
+    const float bf = b;
+    const float min = MINRGB(rf, gf, bf);
+    const float max = MAXRGB(rf, gf, bf);
+    float hue = 0;
+    float sat = 0;
+
+    if (max > 0) {
+        sat = (max - min) / max * 255;
+
+        if (sat > 0) {
+            if (max == rf) {
+                if (gf >= bf) {
+                    hue = 60 * (gf - bf) / (max - min);
+                } else {
+                    hue = 360 + 60 * (gf - bf) / (max - min);
                 }
+            } else if (max == gf) {
+                hue = 120 + 60 * (bf - rf) / (max - min);
+            } else if (max == bf) {
+                hue = 240 + 60 * (rf - gf) / (max - min);
             }
+            hue = hue / 360 * 255;
         }
     }
+    *h = (unsigned char)hue;
+    *s = (unsigned char)sat;
+    *v = (unsigned char)max;
+}
 
-    // Volta a etiquetar a imagem
-    for (y = 1; y < height - 1; y++) {
-        for (x = 1; x < width - 1; x++) {
-            posX = y * bytesperline + x * channels; // X
-            if (datadst[posX] != 0) datadst[posX] = labeltable[datadst[posX]];
-        }
+
+#if defined(VC_SIMD_AVX2)
+/**
+ * @brief Conversao RGB para HSV de 8 pixeis em paralelo (AVX2)
+ *
+ * Repete as mesmas operacoes em virgula flutuante da versao escalar,
+ * substituindo os ramos por mascaras, pelo que o resultado e identico.
+ */
+static __m256i vc_rgb_to_hsv_avx2_8(const __m256 r, const __m256 g, const __m256 b, __m256i* s, __m256i* v)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 max = _mm256_max_ps(_mm256_max_ps(r, g), b);
+    const __m256 min = _mm256_min_ps(_mm256_min_ps(r, g), b);
+    const __m256 delta = _mm256_sub_ps(max, min);
+    const __m256 valid = _mm256_cmp_ps(delta, zero, _CMP_GT_OQ);
+    const __m256 isr = _mm256_cmp_ps(max, r, _CMP_EQ_OQ);
+    const __m256 isg = _mm256_andnot_ps(isr, _mm256_cmp_ps(max, g, _CMP_EQ_OQ));
+    const __m256 gneg = _mm256_cmp_ps(g, b, _CMP_LT_OQ);
+    __m256 num = _mm256_sub_ps(r, g);
+    __m256 off = _mm256_set1_ps(240.0f);
+
+    num = _mm256_blendv_ps(num, _mm256_sub_ps(b, r), isg);
+    num = _mm256_blendv_ps(num, _mm256_sub_ps(g, b), isr);
+    off = _mm256_blendv_ps(off, _mm256_set1_ps(120.0f), isg);
+    off = _mm256_blendv_ps(off, _mm256_and_ps(gneg, _mm256_set1_ps(360.0f)), isr);
+
+    __m256 hue = _mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(60.0f), num), _mm256_max_ps(delta, one));
+    hue = _mm256_add_ps(off, hue);
+    hue = _mm256_mul_ps(_mm256_div_ps(hue, _mm256_set1_ps(360.0f)), _mm256_set1_ps(255.0f));
+    hue = _mm256_and_ps(hue, valid);
+
+    const __m256 sat = _mm256_mul_ps(_mm256_div_ps(delta, _mm256_max_ps(max, one)), _mm256_set1_ps(255.0f));
+
+    *s = _mm256_cvttps_epi32(sat);
+    *v = _mm256_cvttps_epi32(max);
+    return _mm256_cvttps_epi32(hue);
+}
+
+
+/**
+ * @brief Empacota 2x8 inteiros de 32 bits em 16 bytes (saturado)
+ */
+static __m128i vc_pack_avx2_16(const __m256i lo, const __m256i hi)
+{
+    const __m128i a = _mm_packs_epi32(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+    const __m128i b = _mm_packs_epi32(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+    return _mm_packus_epi16(a, b);
+}
+#elif defined(VC_SIMD_SSE2)
+/**
+ * @brief Seleciona b onde a mascara esta ativa, a caso contrario
+ */
+static __m128 vc_select_ps(const __m128 mask, const __m128 a, const __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+
+/**
+ * @brief Conversao RGB para HSV de 4 pixeis em paralelo (SSE2)
+ *
+ * Repete as mesmas operacoes em virgula flutuante da versao escalar,
+ * substituindo os ramos por mascaras, pelo que o resultado e identico.
+ */
+static __m128i vc_rgb_to_hsv_sse2_4(const __m128 r, const __m128 g, const __m128 b, __m128i* s, __m128i* v)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 max = _mm_max_ps(_mm_max_ps(r, g), b);
+    const __m128 min = _mm_min_ps(_mm_min_ps(r, g), b);
+    const __m128 delta = _mm_sub_ps(max, min);
+    const __m128 valid = _mm_cmpgt_ps(delta, zero);
+    const __m128 isr = _mm_cmpeq_ps(max, r);
+    const __m128 isg = _mm_andnot_ps(isr, _mm_cmpeq_ps(max, g));
+    const __m128 gneg = _mm_cmplt_ps(g, b);
+    __m128 num = _mm_sub_ps(r, g);
+    __m128 off = _mm_set1_ps(240.0f);
+
+    num = vc_select_ps(isg, num, _mm_sub_ps(b, r));
+    num = vc_select_ps(isr, num, _mm_sub_ps(g, b));
+    off = vc_select_ps(isg, off, _mm_set1_ps(120.0f));
+    off = vc_select_ps(isr, off, _mm_and_ps(gneg, _mm_set1_ps(360.0f)));
+
+    __m128 hue = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(60.0f), num), _mm_max_ps(delta, one));
+    hue = _mm_add_ps(off, hue);
+    hue = _mm_mul_ps(_mm_div_ps(hue, _mm_set1_ps(360.0f)), _mm_set1_ps(255.0f));
+    hue = _mm_and_ps(hue, valid);
+
+    const __m128 sat = _mm_mul_ps(_mm_div_ps(delta, _mm_max_ps(max, one)), _mm_set1_ps(255.0f));
+
+    *s = _mm_cvttps_epi32(sat);
+    *v = _mm_cvttps_epi32(max);
+    return _mm_cvttps_epi32(hue);
+}
+#endif
+
+
+#if defined(VC_SIMD_SSE2)
+/**
+ * @brief Le 16 pixeis RGB intercalados e separa os tres canais (SSE2)
+ *
+ * @param rgb Pixeis de entrada (48 bytes)
+ * @param r Canal vermelho
+ * @param g Canal verde
+ * @param b Canal azul
+ */
+static void vc_load_rgb_sse2(const unsigned char* rgb, __m128i* r, __m128i* g, __m128i* b)
+{
+    const __m128i t00 = _mm_loadu_si128((const __m128i*)rgb);
+    const __m128i t01 = _mm_loadu_si128((const __m128i*)(rgb + 16));
+    const __m128i t02 = _mm_loadu_si128((const __m128i*)(rgb + 32));
+
+    const __m128i t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+    const __m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+    const __m128i t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+
+    const __m128i t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+    const __m128i t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+    const __m128i t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+    const __m128i t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+    const __m128i t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+    const __m128i t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+    *r = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+    *g = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+    *b = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+}
+
+
+/**
+ * @brief Intercala tres canais de 16 pixeis e escreve-os (SSE2)
+ *
+ * @param dst Pixeis de saida (48 bytes)
+ * @param a Primeiro canal
+ * @param b Segundo canal
+ * @param c Terceiro canal
+ */
+static void vc_store_3ch_sse2(unsigned char* dst, const __m128i a, const __m128i b, const __m128i c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ab0 = _mm_unpacklo_epi8(a, b);
+    const __m128i ab1 = _mm_unpackhi_epi8(a, b);
+    const __m128i c0 = _mm_unpacklo_epi8(c, zero);
+    const __m128i c1 = _mm_unpackhi_epi8(c, zero);
+
+    const __m128i p00 = _mm_unpacklo_epi16(ab0, c0);
+    const __m128i p01 = _mm_unpackhi_epi16(ab0, c0);
+    const __m128i p02 = _mm_unpacklo_epi16(ab1, c1);
+    const __m128i p03 = _mm_unpackhi_epi16(ab1, c1);
+
+    const __m128i p10 = _mm_unpacklo_epi32(p00, p01);
+    const __m128i p11 = _mm_unpackhi_epi32(p00, p01);
+    const __m128i p12 = _mm_unpacklo_epi32(p02, p03);
+    const __m128i p13 = _mm_unpackhi_epi32(p02, p03);
+
+    const __m128i p20 = _mm_slli_si128(_mm_unpacklo_epi64(p10, p11), 1);
+    const __m128i p21 = _mm_unpackhi_epi64(p10, p11);
+    const __m128i p22 = _mm_slli_si128(_mm_unpacklo_epi64(p12, p13), 1);
+    const __m128i p23 = _mm_unpackhi_epi64(p12, p13);
+
+    const __m128i p30 = _mm_slli_epi64(_mm_unpacklo_epi32(p20, p21), 8);
+    const __m128i p31 = _mm_srli_epi64(_mm_unpackhi_epi32(p20, p21), 8);
+    const __m128i p32 = _mm_slli_epi64(_mm_unpacklo_epi32(p22, p23), 8);
+    const __m128i p33 = _mm_srli_epi64(_mm_unpackhi_epi32(p22, p23), 8);
+
+    const __m128i p40 = _mm_unpacklo_epi64(p30, p31);
+    const __m128i p41 = _mm_unpackhi_epi64(p30, p31);
+    const __m128i p42 = _mm_unpacklo_epi64(p32, p33);
+    const __m128i p43 = _mm_unpackhi_epi64(p32, p33);
+
+    _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_srli_si128(p40, 2), _mm_slli_si128(p41, 10)));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_srli_si128(p41, 6), _mm_slli_si128(p42, 6)));
+    _mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(_mm_srli_si128(p42, 10), _mm_slli_si128(p43, 2)));
+}
+
+
+/**
+ * @brief Conversao RGB para HSV de 16 pixeis intercalados
+ *
+ * @param rgb Pixeis de entrada (48 bytes)
+ * @param h Matiz dos 16 pixeis
+ * @param s Saturacao dos 16 pixeis
+ * @param v Valor dos 16 pixeis
+ */
+static void vc_rgb_to_hsv_16(const unsigned char* rgb, __m128i* h, __m128i* s, __m128i* v)
+{
+    __m128i r8, g8, b8;
+
+    vc_load_rgb_sse2(rgb, &r8, &g8, &b8);
+
+#if defined(VC_SIMD_AVX2)
+    __m256i hq[2], sq[2], vq[2];
+
+    for (int q = 0; q < 2; q++) {
+        const __m256 r = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(q ? _mm_srli_si128(r8, 8) : r8));
+        const __m256 g = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(q ? _mm_srli_si128(g8, 8) : g8));
+        const __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(q ? _mm_srli_si128(b8, 8) : b8));
+        hq[q] = vc_rgb_to_hsv_avx2_8(r, g, b, &sq[q], &vq[q]);
+    }
+    *h = vc_pack_avx2_16(hq[0], hq[1]);
+    *s = vc_pack_avx2_16(sq[0], sq[1]);
+    *v = vc_pack_avx2_16(vq[0], vq[1]);
+#else
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i r16[2] = { _mm_unpacklo_epi8(r8, zero), _mm_unpackhi_epi8(r8, zero) };
+    const __m128i g16[2] = { _mm_unpacklo_epi8(g8, zero), _mm_unpackhi_epi8(g8, zero) };
+    const __m128i b16[2] = { _mm_unpacklo_epi8(b8, zero), _mm_unpackhi_epi8(b8, zero) };
+    __m128i hq[4], sq[4], vq[4];
+
+    for (int q = 0; q < 4; q++) {
+        const __m128i r32 = (q & 1) ? _mm_unpackhi_epi16(r16[q >> 1], zero) : _mm_unpacklo_epi16(r16[q >> 1], zero);
+        const __m128i g32 = (q & 1) ? _mm_unpackhi_epi16(g16[q >> 1], zero) : _mm_unpacklo_epi16(g16[q >> 1], zero);
+        const __m128i b32 = (q & 1) ? _mm_unpackhi_epi16(b16[q >> 1], zero) : _mm_unpacklo_epi16(b16[q >> 1], zero);
+        hq[q] = vc_rgb_to_hsv_sse2_4(_mm_cvtepi32_ps(r32), _mm_cvtepi32_ps(g32), _mm_cvtepi32_ps(b32), &sq[q], &vq[q]);
     }
+    *h = _mm_packus_epi16(_mm_packs_epi32(hq[0], hq[1]), _mm_packs_epi32(hq[2], hq[3]));
+    *s = _mm_packus_epi16(_mm_packs_epi32(sq[0], sq[1]), _mm_packs_epi32(sq[2], sq[3]));
+    *v = _mm_packus_epi16(_mm_packs_epi32(vq[0], vq[1]), _mm_packs_epi32(vq[2], vq[3]));
+#endif
+}
+#endif
 
-    // Contagem do numero de blobs
-    // Passo 1: Eliminar, da tabela, etiquetas repetidas
-    for (a = 1; a < label - 1; a++) {
-        for (int b = a + 1; b < label; b++) {
-            if (labeltable[a] == labeltable[b]) labeltable[b] = 0;
+
+/**
+ * @brief Conversao de RGB para HSV
+ *
+ * Converte blocos de 16 pixeis com SSE2/AVX2 quando disponivel; os restantes
+ * pixeis usam a versao escalar. O resultado e identico ao de vc_rgb_to_hsv_scalar().
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
+ */
+int vc_rgb_to_hsv(const IVC* src, const IVC* dst) {
+    const unsigned char* data_src = src->data;
+    unsigned char* data_dst = dst->data;
+    const int width = src->width;
+    const int height = src->height;
+    const int bytesperline_src = src->bytesperline;
+    const int bytesperline_dst = dst->bytesperline;
+
+    if (width <= 0 || height <= 0 || data_src == NULL) return 0;
+    if (src->channels != 3 || dst->channels != 3) return 0;
+    if (width != dst->width || height != dst->height) return 0;
+
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row_src = data_src + y * bytesperline_src;
+        unsigned char* row_dst = data_dst + y * bytesperline_dst;
+        int x = 0;
+
+#if defined(VC_SIMD_SSE2)
+        for (; x + 16 <= width; x += 16) {
+            __m128i h, s, v;
+            vc_rgb_to_hsv_16(row_src + x * 3, &h, &s, &v);
+            vc_store_3ch_sse2(row_dst + x * 3, h, s, v);
+        }
+#endif
+
+        // Pixeis restantes (ou todos, sem SIMD)
+        for (; x < width; x++) {
+            vc_rgb_to_hsv_pixel(row_src[x * 3], row_src[x * 3 + 1], row_src[x * 3 + 2],
+                                &row_dst[x * 3], &row_dst[x * 3 + 1], &row_dst[x * 3 + 2]);
         }
     }
+    return 1;
+}
 
-    // Passo 2: Conta etiquetas e organiza a tabela de etiquetas, para que nao hajam valores vazios (zero) entre etiquetas
-    *nlabels = 0;
-    for (a = 1; a < label; a++) {
-        if (labeltable[a] != 0) {
-            labeltable[*nlabels] = labeltable[a]; // Organiza tabela de etiquetas
-            (*nlabels)++;						  // Conta etiquetas
+
+/**
+ * @brief Conversao de RGB para HSV (versao escalar de referencia)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
+ */
+int vc_rgb_to_hsv_scalar(const IVC* src, const IVC* dst) {
+    const unsigned char * data_src = src->data;
+    unsigned char* data_dst = dst->data;
+    const int width_src = src->width;
+    const int width_dst = dst->width;
+    const int height_src = src->height;
+    const int height_dst = dst->height;
+    const int channels_src = src->channels;
+    const int channel_dst = dst->channels;
+    int bytesperline_src = src->bytesperline, bytesperline_dst = dst->bytesperline;
+
+    if (width_src <= 0 || height_src <= 0 || data_src == NULL) return 0;
+    if (channels_src != 3 || channel_dst != 3) return 0;
+    if (width_src != width_dst || height_src != height_dst) return 0;
+
+    for (int y = 0; y < height_src; y++) {
+        for (int x = 0; x < width_src; x++) {
+            const int pos_src = y * bytesperline_src + x * channels_src;
+            const int pos_dst = y * bytesperline_dst + x * channel_dst;
+
+            vc_rgb_to_hsv_pixel(data_src[pos_src], data_src[pos_src + 1], data_src[pos_src + 2],
+                                &data_dst[pos_dst], &data_dst[pos_dst + 1], &data_dst[pos_dst + 2]);
         }
     }
+    return 1;
+}
 
-    // Se nao ha blobs
-    if (*nlabels == 0) return NULL;
 
-    // Cria lista de blobs (objetos) e preenche a etiqueta
-    OVC* blobs = calloc(*nlabels, sizeof(OVC));
-    if (blobs != NULL) {
-        for (a = 0; a < *nlabels; a++) blobs[a].label = labeltable[a];
-    } else {
-        return NULL;
-    }
-    return blobs;
+/**
+ * @brief Inicializa uma tabela de segmentacao HSV vazia
+ *
+ * @param lut Tabela de segmentacao
+ */
+void vc_hsv_lut_init(SVC* lut)
+{
+    memset(lut, 0, sizeof(SVC));
+}
+
+
+/**
+ * @brief Acrescenta um intervalo HSV a uma tabela de segmentacao
+ *
+ * Cada intervalo ocupa um bit nas tabelas por canal: o bit fica ativo nos
+ * bytes H, S e V que cumprem o respetivo limite. Um pixel pertence ao
+ * intervalo se o bit estiver ativo nas tres tabelas.
+ *
+ * @param lut Tabela de segmentacao
+ * @param hMin Valor minimo de matiz - [0, 360] (exclusivo)
+ * @param hMax Valor maximo de matiz - [0, 360]
+ * @param sMin Valor minimo de saturação - [0, 100]
+ * @param sMax Valor maximo de saturação - [0, 100]
+ * @param vMin Valor minimo de valor - [0, 100]
+ * @param vMax Valor maximo de valor - [0, 100]
+ * @return int Indice (bit) do intervalo, ou -1 se a tabela estiver cheia
+ */
+int vc_hsv_lut_add(SVC* lut, int hMin, int hMax, int sMin, int sMax, int vMin, int vMax)
+{
+    if (lut == NULL || lut->nranges >= VC_HSV_LUT_MAX) return -1;
+
+    const int index = lut->nranges++;
+    const unsigned int bit = 1u << index;
+
+    for (int b = 0; b < 256; b++) {
+        const int h = (float)b / 255.0f * 360.0f;
+        const int s = (float)b / 255.0f * 100.0f;
+        const int v = (float)b / 255.0f * 100.0f;
+
+        if (h > hMin && h <= hMax) lut->h[b] |= bit;
+        if (s >= sMin && s <= sMax) lut->s[b] |= bit;
+        if (v >= vMin && v <= vMax) lut->v[b] |= bit;
+    }
+    return index;
+}
+
+
+/**
+ * @brief Segmentacao de uma imagem HSV por tabela
+ *
+ * @param src Imagem HSV de entrada
+ * @param dst Imagem de saida (255 nos pixeis aceites, 0 nos restantes)
+ * @param lut Tabela de segmentacao
+ * @param mask Intervalos a aceitar (um bit por intervalo)
+ * @return int
+ */
+int vc_hsv_segmentation_lut(const IVC* src, const IVC* dst, const SVC* lut, const unsigned int mask)
+{
+    const unsigned char* data = src->data;
+    unsigned char* dstdata = dst->data;
+    const int width = src->width;
+    const int height = src->height;
+    const int channels = src->channels;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || lut == NULL)
+        return 0;
+    if (channels != 3 || dst->channels != 3)
+        return 0;
+
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* in = data + y * src->bytesperline;
+        unsigned char* out = dstdata + y * dst->bytesperline;
+
+        for (int i = 0; i < width * channels; i = i + channels)
+        {
+            const unsigned char value = VC_HSV_LUT(lut, in[i], in[i + 1], in[i + 2]) & mask ? 255 : 0;
+
+            out[i] = value;
+            out[i + 1] = value;
+            out[i + 2] = value;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Classificacao de uma imagem HSV por todos os intervalos de uma tabela
+ *
+ * Numa unica passagem, regista para cada intervalo a coordenada x do primeiro
+ * pixel aceite (em ordem de varrimento) e, opcionalmente, etiqueta cada pixel
+ * com o indice + 1 do primeiro intervalo que o aceita (0 se nenhum). Sem imagem
+ * de saida, a passagem termina assim que todos os intervalos forem encontrados.
+ *
+ * @param src Imagem HSV de entrada
+ * @param dst Imagem de etiquetas (1 canal) ou NULL
+ * @param lut Tabela de segmentacao
+ * @param firstx Coordenada x do primeiro pixel de cada intervalo (-1 se ausente)
+ * @return int
+ */
+int vc_hsv_lut_classify(const IVC* src, const IVC* dst, const SVC* lut, int* firstx)
+{
+    const unsigned char* data = src->data;
+    const int width = src->width;
+    const int height = src->height;
+    const int bytesperline = src->bytesperline;
+    unsigned int pending;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || lut == NULL || firstx == NULL) return 0;
+    if (src->channels != 3) return 0;
+    if (dst != NULL && (dst->width != width || dst->height != height || dst->channels != 1)) return 0;
+
+    for (int i = 0; i < lut->nranges; i++) firstx[i] = -1;
+    pending = lut->nranges >= 32 ? ~0u : (1u << lut->nranges) - 1;
+
+    for (int y = 0; y < height && (pending != 0 || dst != NULL); y++) {
+        const unsigned char* row = data + y * bytesperline;
+
+        for (int x = 0; x < width; x++) {
+            const unsigned int hit = VC_HSV_LUT(lut, row[x * 3], row[x * 3 + 1], row[x * 3 + 2]);
+
+            if (hit & pending) {
+                unsigned int bits = hit & pending;
+                for (int i = 0; bits != 0; i++, bits >>= 1) {
+                    if (bits & 1) firstx[i] = x;
+                }
+                pending &= ~hit;
+            }
+
+            if (dst != NULL) {
+                int label = 0;
+                if (hit != 0) {
+                    while (!(hit & (1u << label))) label++;
+                    label++;
+                }
+                dst->data[y * dst->bytesperline + x] = (unsigned char)label;
+            } else if (pending == 0) {
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Segmentacao de uma imagem em HSV
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param hMin Valor minimo de matiz - [0, 360]
+ * @param hMax Valor maximo de matiz - [0, 360]
+ * @param sMin Valor minimo de saturação - [0, 100]
+ * @param sMax Valor maximo de saturação - [0, 100]
+ * @param vMin Valor minimo de valor - [0, 100]
+ * @param vMax Valor maximo de valor - [0, 100]
+ * @return int
+ */
+int vc_hsv_segmentation(const IVC* src, const IVC* dst, int hMin, int hMax, int sMin, int sMax, int vMin, int vMax)
+{
+    SVC lut;
+
+    vc_hsv_lut_init(&lut);
+    vc_hsv_lut_add(&lut, hMin, hMax, sMin, sMax, vMin, vMax);
+
+    return vc_hsv_segmentation_lut(src, dst, &lut, 1u);
+}
+
+
+/**
+ * @brief Intervalo de bytes de um canal aceites por um unico intervalo da tabela
+ *
+ * Como a conversao de byte para graus/percentagem e monotona, os bytes aceites
+ * por um intervalo formam um intervalo [lo, hi] (vazio se lo > hi).
+ *
+ * @param table Tabela de um canal
+ * @param bit Bit do intervalo
+ * @param lo Primeiro byte aceite
+ * @param hi Ultimo byte aceite
+ */
+static void vc_hsv_lut_bounds(const unsigned int* table, const unsigned int bit, unsigned char* lo, unsigned char* hi)
+{
+    *lo = 1;
+    *hi = 0;
+
+    for (int b = 0; b < 256; b++) {
+        if (table[b] & bit) {
+            if (*lo > *hi) *lo = (unsigned char)b;
+            *hi = (unsigned char)b;
+        }
+    }
+}
+
+
+#if defined(VC_SIMD_SSE2)
+/**
+ * @brief Mascara dos bytes dentro de [lo, hi] (SSE2)
+ */
+static __m128i vc_in_range_sse2(const __m128i x, const __m128i lo, const __m128i hi)
+{
+    return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, lo), x), _mm_cmpeq_epi8(_mm_min_epu8(x, hi), x));
+}
+#endif
+
+
+/**
+ * @brief Segmentacao HSV direta de uma imagem RGB para uma mascara binaria
+ *
+ * Equivale a vc_rgb_to_hsv() + vc_hsv_segmentation_lut() + vc_rgb_to_gray(), mas
+ * le a imagem RGB uma unica vez e escreve diretamente a mascara (1 canal, 0/255),
+ * sem imagens intermedias. Com um unico intervalo, o teste e feito por comparacao
+ * de bytes em SIMD; com varios, por consulta da tabela.
+ *
+ * @param src Imagem RGB de entrada
+ * @param dst Mascara de saida (1 canal)
+ * @param lut Tabela de segmentacao
+ * @param mask Intervalos a aceitar (um bit por intervalo)
+ * @return int
+ */
+int vc_rgb_to_hsv_mask(const IVC* src, const IVC* dst, const SVC* lut, const unsigned int mask)
+{
+    const unsigned char* data_src = src->data;
+    unsigned char* data_dst = dst->data;
+    const int width = src->width;
+    const int height = src->height;
+    const int bytesperline_src = src->bytesperline;
+    const int bytesperline_dst = dst->bytesperline;
+    const int single = mask != 0 && (mask & (mask - 1)) == 0;
+    unsigned char lo[3] = { 1, 1, 1 }, hi[3] = { 0, 0, 0 };
+
+    // Verificacao de erros
+    if (width <= 0 || height <= 0 || data_src == NULL || data_dst == NULL || lut == NULL) return 0;
+    if (src->channels != 3 || dst->channels != 1) return 0;
+    if (width != dst->width || height != dst->height) return 0;
+
+    if (single) {
+        vc_hsv_lut_bounds(lut->h, mask, &lo[0], &hi[0]);
+        vc_hsv_lut_bounds(lut->s, mask, &lo[1], &hi[1]);
+        vc_hsv_lut_bounds(lut->v, mask, &lo[2], &hi[2]);
+    }
+
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row_src = data_src + y * bytesperline_src;
+        unsigned char* row_dst = data_dst + y * bytesperline_dst;
+        int x = 0;
+
+#if defined(VC_SIMD_SSE2)
+        if (single) {
+            const __m128i hlo = _mm_set1_epi8((char)lo[0]), hhi = _mm_set1_epi8((char)hi[0]);
+            const __m128i slo = _mm_set1_epi8((char)lo[1]), shi = _mm_set1_epi8((char)hi[1]);
+            const __m128i vlo = _mm_set1_epi8((char)lo[2]), vhi = _mm_set1_epi8((char)hi[2]);
+
+            for (; x + 16 <= width; x += 16) {
+                __m128i h, s, v;
+                vc_rgb_to_hsv_16(row_src + x * 3, &h, &s, &v);
+
+                const __m128i in = _mm_and_si128(vc_in_range_sse2(h, hlo, hhi),
+                                   _mm_and_si128(vc_in_range_sse2(s, slo, shi), vc_in_range_sse2(v, vlo, vhi)));
+                _mm_storeu_si128((__m128i*)(row_dst + x), in);
+            }
+        } else {
+            unsigned char h8[16], s8[16], v8[16];
+
+            for (; x + 16 <= width; x += 16) {
+                __m128i h, s, v;
+                vc_rgb_to_hsv_16(row_src + x * 3, &h, &s, &v);
+                _mm_storeu_si128((__m128i*)h8, h);
+                _mm_storeu_si128((__m128i*)s8, s);
+                _mm_storeu_si128((__m128i*)v8, v);
+
+                for (int i = 0; i < 16; i++) {
+                    row_dst[x + i] = VC_HSV_LUT(lut, h8[i], s8[i], v8[i]) & mask ? 255 : 0;
+                }
+            }
+        }
+#endif
+
+        for (; x < width; x++) {
+            unsigned char h, s, v;
+            vc_rgb_to_hsv_pixel(row_src[x * 3], row_src[x * 3 + 1], row_src[x * 3 + 2], &h, &s, &v);
+
+            row_dst[x] = VC_HSV_LUT(lut, h, s, v) & mask ? 255 : 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Conversao de RGB para escala de cinza
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
+ */
+int vc_rgb_to_gray(const IVC* src, const IVC* dst)
+{
+    unsigned char* datasrc = src->data;
+    int bytesperline_src = src->bytesperline;
+    const int channels_src = src->channels;
+    unsigned char* datadst = dst->data;
+    int bytesperline_dst = dst->bytesperline;
+    const int channels_dst = dst->channels;
+    const int width = src->width;
+    const int height = src->height;
+
+    //verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL)
+        return 0;
+    if (src->width != dst->width || src->height != dst->height)
+        return 0;
+    if (src->channels != 3 || dst->channels != 1)
+        return 0;
+
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const long int pos_src = y * bytesperline_src + x * channels_src;
+            const long int pos_dst = y * bytesperline_dst + x * channels_dst;
+            const float rf = datasrc[pos_src];
+            const float gf = datasrc[pos_src + 1];
+            const float bf = datasrc[pos_src + 2];
+
+            datadst[pos_dst] = (unsigned char)(rf * 0.299 + gf * 0.587 + bf * 0.114);
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Conversao de YUV planar (Y4M) para RGB, segundo a BT.601
+ *
+ * src contem o plano Y (width x height) seguido dos planos U e V, com metade da largura e
+ * da altura (arredondadas para cima) em VC_YUV_420 e a resolucao total em VC_YUV_444.
+ * Em VC_YUV_MONO so ha o plano Y.
+ *
+ * @param src Planos YUV
+ * @param format VC_YUV_MONO, VC_YUV_420 ou VC_YUV_444
+ * @param fullrange 1 se Y, U e V ocupam [0, 255]; 0 se Y ocupa [16, 235] e U, V [16, 240]
+ * @param dst Imagem de saida (RGB)
+ * @return int
+ */
+int vc_yuv_to_rgb(const unsigned char* src, const int format, const int fullrange, const IVC* dst)
+{
+    if (src == NULL || dst == NULL || dst->data == NULL || dst->channels != 3) return 0;
+    if (dst->width <= 0 || dst->height <= 0) return 0;
+    if (format != VC_YUV_MONO && format != VC_YUV_420 && format != VC_YUV_444) return 0;
+
+    const int width = dst->width;
+    const int height = dst->height;
+    const int shift = format == VC_YUV_420 ? 1 : 0;
+    const int cwidth = (width + shift) >> shift;
+    const int cheight = (height + shift) >> shift;
+    const unsigned char* planeu = src + (size_t)width * height;
+    const unsigned char* planev = planeu + (size_t)cwidth * cheight;
+
+    // Coeficientes em virgula fixa (x256)
+    const int ky = fullrange ? 256 : 298, y0 = fullrange ? 0 : 16;
+    const int krv = fullrange ? 359 : 409, kgu = fullrange ? 88 : 100, kgv = fullrange ? 183 : 208, kbu = fullrange ? 454 : 516;
+
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y++) {
+        const unsigned char* rowy = src + (size_t)y * width;
+        const unsigned char* rowu = planeu + (size_t)(y >> shift) * cwidth;
+        const unsigned char* rowv = planev + (size_t)(y >> shift) * cwidth;
+        unsigned char* out = dst->data + (size_t)y * dst->bytesperline;
+
+        for (int x = 0; x < width; x++) {
+            const int c = ky * (rowy[x] - y0) + 128;
+            int r = c >> 8, g = r, b = r;
+
+            if (format != VC_YUV_MONO) {
+                const int d = rowu[x >> shift] - 128;
+                const int e = rowv[x >> shift] - 128;
+
+                r = (c + krv * e) >> 8;
+                g = (c - kgu * d - kgv * e) >> 8;
+                b = (c + kbu * d) >> 8;
+            }
+
+            out[3 * x] = (unsigned char)MIN(MAX(r, 0), 255);
+            out[3 * x + 1] = (unsigned char)MIN(MAX(g, 0), 255);
+            out[3 * x + 2] = (unsigned char)MIN(MAX(b, 0), 255);
+        }
+    }
+    return 1;
+}
+
+
+// Somas deslizantes de uma janela quadrada (com a janela limitada a imagem)
+typedef struct {
+    const IVC* src;         // Imagem de entrada (ou copia, se src == dst)
+    IVC* copy;              // Copia propria da entrada (NULL se nao houver)
+    int r;                  // Raio do kernel
+    int y;                  // Linha atual (-1 antes da primeira)
+    unsigned int* colsum;   // Soma de cada coluna nas linhas da janela (com r + 1 zeros de cada lado)
+    unsigned int* colsq;    // Idem, para os quadrados (NULL se nao for pedido)
+    unsigned int* sum;      // Soma da janela de cada pixel da linha atual
+    unsigned int* sq;       // Soma dos quadrados da janela de cada pixel da linha atual
+    int* ncols;             // Numero de colunas da janela de cada x
+    int nrows;              // Numero de linhas da janela da linha atual
+} VC_BOX;
+
+
+/**
+ * @brief Prepara as somas deslizantes de uma janela kernel x kernel
+ *
+ * As somas usam aritmetica de 32 bits sem sinal; com kernel <= 255 nem a soma
+ * dos quadrados de uma janela excede 2^32.
+ *
+ * @param box Estado das somas
+ * @param src Imagem de entrada (1 canal)
+ * @param dst Imagem de saida (se for a de entrada, trabalha-se sobre uma copia)
+ * @param kernel Tamanho do kernel
+ * @param squares 1 para acumular tambem os quadrados (variancia)
+ * @return int
+ */
+static int vc_box_begin(VC_BOX* box, const IVC* src, const IVC* dst, const int kernel, const int squares)
+{
+    const int width = src->width;
+    const int r = kernel / 2;
+    const size_t padded = (size_t)width + 2 * r + 2;
+
+    memset(box, 0, sizeof(VC_BOX));
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+    if (src->channels != 1 || dst->channels != 1) return 0;
+    if (kernel < 1 || kernel > 255 || kernel % 2 == 0) return 0;
+
+    box->src = src;
+    box->r = r;
+    box->y = -1;
+
+    if (src->data == dst->data) {
+        box->copy = vc_image_new(src->width, src->height, 1, src->levels);
+        if (box->copy == NULL) return 0;
+        for (int y = 0; y < src->height; y++) memcpy(box->copy->data + y * box->copy->bytesperline, src->data + y * src->bytesperline, width);
+        box->src = box->copy;
+    }
+
+    box->colsum = calloc(padded, sizeof(unsigned int));
+    box->sum = malloc(width * sizeof(unsigned int));
+    box->ncols = malloc(width * sizeof(int));
+    if (squares) {
+        box->colsq = calloc(padded, sizeof(unsigned int));
+        box->sq = malloc(width * sizeof(unsigned int));
+    }
+
+    if (box->colsum == NULL || box->sum == NULL || box->ncols == NULL || (squares && (box->colsq == NULL || box->sq == NULL))) return 0;
+
+    for (int x = 0; x < width; x++) box->ncols[x] = MIN(x + r, width - 1) - MAX(x - r, 0) + 1;
+
+    // Linhas 0..r-1 da janela da primeira linha (a linha r entra em vc_box_next)
+    for (int y = 0; y < MIN(r, src->height); y++) {
+        const unsigned char* row = box->src->data + y * box->src->bytesperline;
+        for (int x = 0; x < width; x++) {
+            box->colsum[x + r + 1] += row[x];
+            if (squares) box->colsq[x + r + 1] += row[x] * row[x];
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Avanca para a linha seguinte e calcula as somas da janela de cada pixel
+ *
+ * As somas de coluna recebem a linha que entra e perdem a que sai; as somas da
+ * janela obtem-se com uma soma deslizante ao longo da linha. As colunas fora da
+ * imagem estao a zero, pelo que nao ha testes de margem no ciclo interior.
+ *
+ * @param box Estado das somas
+ */
+static void vc_box_next(VC_BOX* box)
+{
+    const IVC* src = box->src;
+    const int width = src->width;
+    const int r = box->r;
+    const int y = ++box->y;
+    unsigned int* colsum = box->colsum;
+    unsigned int* colsq = box->colsq;
+
+    if (y + r < src->height) {
+        const unsigned char* row = src->data + (y + r) * src->bytesperline;
+        for (int x = 0; x < width; x++) colsum[x + r + 1] += row[x];
+        if (colsq) for (int x = 0; x < width; x++) colsq[x + r + 1] += row[x] * row[x];
+    }
+    if (y - r - 1 >= 0) {
+        const unsigned char* row = src->data + (y - r - 1) * src->bytesperline;
+        for (int x = 0; x < width; x++) colsum[x + r + 1] -= row[x];
+        if (colsq) for (int x = 0; x < width; x++) colsq[x + r + 1] -= row[x] * row[x];
+    }
+    box->nrows = MIN(y + r, src->height - 1) - MAX(y - r, 0) + 1;
+
+    // colsum[i] corresponde a coluna i - r - 1; a janela de x e [x - r, x + r]
+    unsigned int s = 0, q = 0;
+    for (int i = 1; i <= 2 * r + 1; i++) s += colsum[i];
+    for (int x = 0; x < width; x++) {
+        box->sum[x] = s;
+        s += colsum[x + 2 * r + 2] - colsum[x + 1];
+    }
+
+    if (colsq) {
+        for (int i = 1; i <= 2 * r + 1; i++) q += colsq[i];
+        for (int x = 0; x < width; x++) {
+            box->sq[x] = q;
+            q += colsq[x + 2 * r + 2] - colsq[x + 1];
+        }
+    }
+}
+
+
+/**
+ * @brief Liberta o estado das somas deslizantes
+ *
+ * @param box Estado das somas
+ */
+static void vc_box_end(VC_BOX* box)
+{
+    vc_image_free(box->copy);
+    free(box->colsum);
+    free(box->colsq);
+    free(box->sum);
+    free(box->sq);
+    free(box->ncols);
+}
+
+
+/**
+ * @brief Media numa janela quadrada de tamanho arbitrario, com custo O(1) por pixel
+ *
+ * Junto a margem a media e feita apenas sobre os pixeis da janela que estao dentro
+ * da imagem. O resultado e truncado.
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kernel Tamanho do kernel (impar)
+ * @return int
+ */
+int vc_gray_box_mean(const IVC* src, const IVC* dst, const int kernel)
+{
+    VC_BOX box;
+
+    if (!vc_box_begin(&box, src, dst, kernel, 0)) {
+        vc_box_end(&box);
+        return 0;
+    }
+
+    for (int y = 0; y < src->height; y++) {
+        unsigned char* out = dst->data + y * dst->bytesperline;
+
+        vc_box_next(&box);
+        for (int x = 0; x < src->width; x++) out[x] = (unsigned char)(box.sum[x] / (unsigned int)(box.nrows * box.ncols[x]));
+    }
+
+    vc_box_end(&box);
+    return 1;
+}
+
+
+/**
+ * @brief Desvio padrao local numa janela quadrada, com custo O(1) por pixel
+ *
+ * A variancia e E[x^2] - E[x]^2 sobre os pixeis da janela dentro da imagem; o
+ * desvio padrao (0..127) e arredondado.
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kernel Tamanho do kernel (impar)
+ * @return int
+ */
+int vc_gray_box_stddev(const IVC* src, const IVC* dst, const int kernel)
+{
+    VC_BOX box;
+
+    if (!vc_box_begin(&box, src, dst, kernel, 1)) {
+        vc_box_end(&box);
+        return 0;
+    }
+
+    for (int y = 0; y < src->height; y++) {
+        unsigned char* out = dst->data + y * dst->bytesperline;
+
+        vc_box_next(&box);
+        for (int x = 0; x < src->width; x++) {
+            const long long n = box.nrows * box.ncols[x];
+            const long long var = n * box.sq[x] - (long long)box.sum[x] * box.sum[x];
+            out[x] = (unsigned char)(sqrt((double)var) / (double)n + 0.5);
+        }
+    }
+
+    vc_box_end(&box);
+    return 1;
+}
+
+
+/**
+ * @brief Threshold adaptativo de Bradley (media local)
+ *
+ * Um pixel fica a 0 se for inferior ou igual a (1 - t) vezes a media da janela.
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kernel Tamanho do kernel (impar)
+ * @param t Fracao abaixo da media (tipicamente 0.15)
+ * @return int
+ */
+int vc_gray_to_binary_bradley(const IVC* src, const IVC* dst, const int kernel, const float t)
+{
+    VC_BOX box;
+
+    if (!vc_box_begin(&box, src, dst, kernel, 0)) {
+        vc_box_end(&box);
+        return 0;
+    }
+
+    for (int y = 0; y < src->height; y++) {
+        const unsigned char* row = box.src->data + y * box.src->bytesperline;
+        unsigned char* out = dst->data + y * dst->bytesperline;
+
+        vc_box_next(&box);
+        for (int x = 0; x < src->width; x++) {
+            const float n = (float)(box.nrows * box.ncols[x]);
+            out[x] = (float)row[x] * n <= (float)box.sum[x] * (1.0f - t) ? 0 : 255;
+        }
+    }
+
+    vc_box_end(&box);
+    return 1;
+}
+
+
+/**
+ * @brief Threshold adaptativo de Sauvola (media e desvio padrao locais)
+ *
+ * O threshold de cada pixel e m * (1 + k * (s / r - 1)), com m e s a media e o
+ * desvio padrao da janela.
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kernel Tamanho do kernel (impar)
+ * @param k Sensibilidade (tipicamente 0.34)
+ * @param r Gama dinamica do desvio padrao (tipicamente 128)
+ * @return int
+ */
+int vc_gray_to_binary_sauvola(const IVC* src, const IVC* dst, const int kernel, const float k, const float r)
+{
+    VC_BOX box;
+
+    if (r <= 0.0f || !vc_box_begin(&box, src, dst, kernel, 1)) {
+        vc_box_end(&box);
+        return 0;
+    }
+
+    for (int y = 0; y < src->height; y++) {
+        const unsigned char* row = box.src->data + y * box.src->bytesperline;
+        unsigned char* out = dst->data + y * dst->bytesperline;
+
+        vc_box_next(&box);
+        for (int x = 0; x < src->width; x++) {
+            const long long n = box.nrows * box.ncols[x];
+            const long long var = n * box.sq[x] - (long long)box.sum[x] * box.sum[x];
+            const float mean = (float)box.sum[x] / (float)n;
+            const float stddev = (float)sqrt((double)var) / (float)n;
+            const float threshold = mean * (1.0f + k * (stddev / r - 1.0f));
+
+            out[x] = (float)row[x] > threshold ? 255 : 0;
+        }
+    }
+
+    vc_box_end(&box);
+    return 1;
+}
+
+
+/**
+ * @brief Filtro de media passa-baixa em escala de cinza (3x3)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
+ */
+int vc_gray_lowpass_mean_filter(const IVC* src, const IVC* dst)
+{
+    return vc_gray_box_mean(src, dst, 3);
+}
+
+
+/**
+ * @brief Erosao binaria em escala de cinza
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+int vc_binary_erode(const IVC* src, const IVC* dst, int kernel)
+{
+    kernel *= 0.5;
+
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+    if (src->channels != 1 || dst->channels != 1) return 0;
+
+    // Um pixel fica a 0 se algum vizinho for 0, isto e, se o minimo da vizinhanca for 0
+    if (!vc_gray_erode_rect(src, dst, 2 * kernel + 1, 2 * kernel + 1)) return 0;
+
+    for (int y = 0; y < dst->height; y++) {
+        unsigned char* row = dst->data + y * dst->bytesperline;
+        for (int x = 0; x < dst->width; x++) row[x] = row[x] == 0 ? 0 : 255;
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Etiquetagem de blobs
+ *
+ * @param src Imagem binaria de entrada
+ * @param dst Imagem grayscale (ira conter as etiquetas)
+ * @param nlabels Endereco de memoria de uma variavel, onde sera armazenado o numero de etiquetas encontradas.
+ * @return OVC*
+ */
+OVC* vc_binary_blob_labelling(const IVC* src, const IVC* dst, int* nlabels)
+{
+    unsigned char* datasrc = src->data;
+    unsigned char* datadst = dst->data;
+    const int width = src->width;
+    const int height = src->height;
+    int bytesperline = src->bytesperline;
+    const int channels = src->channels;
+    int x, y, a;
+    long int i, size;
+    long int posX;
+    int labeltable[256] = { 0 };
+    int labelarea[256] = { 0 };
+    int label = 1; // Etiqueta inicial.
+    int tmplabel;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL)
+        return 0;
+    if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels)
+        return NULL;
+    if (channels != 1)
+        return NULL;
+
+    // Copia dados da imagem binaria para imagem grayscale
+    // Todos os pixeis de plano de fundo devem obrigatoriamente ter valor 0
+    // Todos os pixeis de primeiro plano devem obrigatoriamente ter valor 255
+    // Serao atribuidas etiquetas no intervalo [1,254]
+    // Este algoritmo esta assim limitado a 255 labels
+    // (linha a linha: numa vista, os bytes entre linhas pertencem a imagem-mae)
+    for (y = 0; y < height; y++) {
+        for (i = y * bytesperline, size = i + width; i < size; i++) {
+            datadst[i] = datasrc[i] != 0 ? 255 : 0;
+        }
+    }
+
+    // Limpa os rebordos da imagem binaria
+    for (y = 0; y < height; y++) {
+        datadst[y * bytesperline + 0 * channels] = 0;
+        datadst[y * bytesperline + (width - 1) * channels] = 0;
+    }
+
+    for (x = 0; x < width; x++) {
+        datadst[0 * bytesperline + x * channels] = 0;
+        datadst[(height - 1) * bytesperline + x * channels] = 0;
+    }
+
+    // Efetua a etiquetagem
+    for (y = 1; y < height - 1; y++) {
+        for (x = 1; x < width - 1; x++) {
+            // Kernel:
+            // A B C
+            // D X
+            const long int posA = (y - 1) * bytesperline + (x - 1) * channels;  // A
+            const long int posB = (y - 1) * bytesperline + x * channels;	    // B
+            const long int posC = (y - 1) * bytesperline + (x + 1) * channels;  // C
+            const long int posD = y * bytesperline + (x - 1) * channels;		// D
+            posX = y * bytesperline + x * channels;				                // X
+
+            // Se o pixel foi marcado
+            if (datadst[posX] != 0) {
+                if (datadst[posA] == 0 && datadst[posB] == 0 && datadst[posC] == 0 && datadst[posD] == 0) {
+                    datadst[posX] = label;
+                    labeltable[label] = label;
+                    label++;
+                } else {
+                    int num = 255;
+                    // Se A esta marcado
+                    if (datadst[posA] != 0)
+                        num = labeltable[datadst[posA]];
+                    // Se B esta marcado, e o menor que a etiqueta "num"
+                    if (datadst[posB] != 0 && labeltable[datadst[posB]] < num)
+                        num = labeltable[datadst[posB]];
+                    // Se C esta marcado, e o menor que a etiqueta "num"
+                    if (datadst[posC] != 0 && labeltable[datadst[posC]] < num)
+                        num = labeltable[datadst[posC]];
+                    // Se D esta marcado, e o menor que a etiqueta "num"
+                    if (datadst[posD] != 0 && labeltable[datadst[posD]] < num)
+                        num = labeltable[datadst[posD]];
+
+                    // Atribui a etiqueta ao pixel
+                    datadst[posX] = num;
+                    labeltable[num] = num;
+
+                    // Atualiza a tabela de etiquetas
+                    if (datadst[posA] != 0) {
+                        if (labeltable[datadst[posA]] != num) {
+                            for (tmplabel = labeltable[datadst[posA]], a = 1; a < label; a++) {
+                                if (labeltable[a] == tmplabel) labeltable[a] = num;
+                            }
+                        }
+                    }
+
+                    if (datadst[posB] != 0) {
+                        if (labeltable[datadst[posB]] != num) {
+                            for (tmplabel = labeltable[datadst[posB]], a = 1; a < label; a++) {
+                                if (labeltable[a] == tmplabel) labeltable[a] = num;
+                            }
+                        }
+                    }
+
+                    if (datadst[posC] != 0) {
+                        if (labeltable[datadst[posC]] != num) {
+                            for (tmplabel = labeltable[datadst[posC]], a = 1; a < label; a++) {
+                                if (labeltable[a] == tmplabel) labeltable[a] = num;
+                            }
+                        }
+                    }
+
+                    if (datadst[posD] != 0) {
+                        if (labeltable[datadst[posD]] != num) {
+                            for (tmplabel = labeltable[datadst[posC]], a = 1; a < label; a++) {
+                                if (labeltable[a] == tmplabel) labeltable[a] = num;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Volta a etiquetar a imagem
+    for (y = 1; y < height - 1; y++) {
+        for (x = 1; x < width - 1; x++) {
+            posX = y * bytesperline + x * channels; // X
+            if (datadst[posX] != 0) datadst[posX] = labeltable[datadst[posX]];
+        }
+    }
+
+    // Contagem do numero de blobs
+    // Passo 1: Eliminar, da tabela, etiquetas repetidas
+    for (a = 1; a < label - 1; a++) {
+        for (int b = a + 1; b < label; b++) {
+            if (labeltable[a] == labeltable[b]) labeltable[b] = 0;
+        }
+    }
+
+    // Passo 2: Conta etiquetas e organiza a tabela de etiquetas, para que nao hajam valores vazios (zero) entre etiquetas
+    *nlabels = 0;
+    for (a = 1; a < label; a++) {
+        if (labeltable[a] != 0) {
+            labeltable[*nlabels] = labeltable[a]; // Organiza tabela de etiquetas
+            (*nlabels)++;						  // Conta etiquetas
+        }
+    }
+
+    // Se nao ha blobs
+    if (*nlabels == 0) return NULL;
+
+    // Cria lista de blobs (objetos) e preenche a etiqueta
+    OVC* blobs = calloc(*nlabels, sizeof(OVC));
+    if (blobs != NULL) {
+        for (a = 0; a < *nlabels; a++) blobs[a].label = labeltable[a];
+    } else {
+        return NULL;
+    }
+    return blobs;
+}
+
+
+// Acumulador das caracteristicas de um blob durante uma passagem pela imagem
+typedef struct {
+    long long sumx, sumy;   // Somas das coordenadas (centro de massa)
+    int xmax, ymax;         // Canto inferior direito da bounding box
+} VC_BLOB_ACC;
+
+
+/**
+ * @brief Inicializa os acumuladores de caracteristicas dos blobs
+ *
+ * @param blobs Lista de blobs
+ * @param acc Acumuladores (um por blob)
+ * @param nblobs Numero de blobs
+ * @param width Largura da imagem
+ * @param height Altura da imagem
+ */
+static void vc_blob_acc_init(OVC* blobs, VC_BLOB_ACC* acc, const int nblobs, const int width, const int height)
+{
+    for (int i = 0; i < nblobs; i++) {
+        blobs[i].x = width - 1;
+        blobs[i].y = height - 1;
+        blobs[i].area = 0;
+        blobs[i].perimeter = 0;
+        acc[i].sumx = 0;
+        acc[i].sumy = 0;
+        acc[i].xmax = 0;
+        acc[i].ymax = 0;
+    }
+}
+
+
+/**
+ * @brief Acumula um pixel nas caracteristicas de um blob
+ *
+ * @param blob Blob
+ * @param acc Acumulador do blob
+ * @param x Coordenada x
+ * @param y Coordenada y
+ * @param contour 1 se o pixel pertence ao contorno
+ */
+static void vc_blob_acc_add(OVC* blob, VC_BLOB_ACC* acc, const int x, const int y, const int contour)
+{
+    blob->area++; // Area
+
+    // Centro de Gravidade
+    acc->sumx += x;
+    acc->sumy += y;
+
+    // Bounding Box
+    if (blob->x > x) blob->x = x;
+    if (blob->y > y) blob->y = y;
+    if (acc->xmax < x) acc->xmax = x;
+    if (acc->ymax < y) acc->ymax = y;
+
+    // Perimetro
+    blob->perimeter += contour;
+}
+
+
+/**
+ * @brief Junta as caracteristicas parciais de um blob (p.ex. de outra faixa da imagem)
+ *
+ * @param blob Blob
+ * @param acc Acumulador do blob
+ * @param part Caracteristicas parciais
+ * @param pacc Acumulador parcial
+ */
+static void vc_blob_acc_merge(OVC* blob, VC_BLOB_ACC* acc, const OVC* part, const VC_BLOB_ACC* pacc)
+{
+    if (part->area == 0) return;
+
+    blob->area += part->area;
+    blob->perimeter += part->perimeter;
+    acc->sumx += pacc->sumx;
+    acc->sumy += pacc->sumy;
+    blob->x = MIN(blob->x, part->x);
+    blob->y = MIN(blob->y, part->y);
+    acc->xmax = MAX(acc->xmax, pacc->xmax);
+    acc->ymax = MAX(acc->ymax, pacc->ymax);
+}
+
+
+/**
+ * @brief Converte os acumuladores em bounding box e centro de massa
+ *
+ * @param blobs Lista de blobs
+ * @param acc Acumuladores (um por blob)
+ * @param nblobs Numero de blobs
+ */
+static void vc_blob_acc_finish(OVC* blobs, const VC_BLOB_ACC* acc, const int nblobs)
+{
+    for (int i = 0; i < nblobs; i++) {
+        // Bounding Box
+        blobs[i].width = acc[i].xmax - blobs[i].x + 1;
+        blobs[i].height = acc[i].ymax - blobs[i].y + 1;
+
+        // Centro de Gravidade
+        blobs[i].xc = (int)(acc[i].sumx / MAX(blobs[i].area, 1));
+        blobs[i].yc = (int)(acc[i].sumy / MAX(blobs[i].area, 1));
+    }
+}
+
+
+/**
+ * @brief Raiz de uma etiqueta provisoria (com compressao de caminho)
+ *
+ * @param parent Tabela de equivalencias
+ * @param label Etiqueta provisoria
+ * @return int
+ */
+static int vc_uf_find(int* parent, int label)
+{
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+
+/**
+ * @brief Une as classes de duas etiquetas provisorias
+ *
+ * A raiz fica sempre a menor etiqueta, pelo que parent[i] <= i.
+ *
+ * @param parent Tabela de equivalencias
+ * @param a Etiqueta provisoria
+ * @param b Etiqueta provisoria
+ * @return int Raiz da classe resultante
+ */
+static int vc_uf_union(int* parent, const int a, const int b)
+{
+    const int ra = vc_uf_find(parent, a);
+    const int rb = vc_uf_find(parent, b);
+
+    if (ra < rb) {
+        parent[rb] = ra;
+        return ra;
+    }
+    parent[ra] = rb;
+    return rb;
+}
+
+
+/**
+ * @brief Leitura atomica de um inteiro partilhado entre threads
+ *
+ * @param p Endereco
+ * @return int
+ */
+static int vc_atomic_load(const int* p)
+{
+#if defined(_MSC_VER)
+    return *(const volatile int*)p;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+
+/**
+ * @brief Compare-and-swap de um inteiro partilhado entre threads
+ *
+ * @param p Endereco
+ * @param expected Valor esperado
+ * @param desired Novo valor
+ * @return int 1 se *p valia expected e passou a valer desired
+ */
+static int vc_atomic_cas(int* p, int expected, const int desired)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange((volatile long*)p, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+
+/**
+ * @brief Raiz de uma etiqueta provisoria, segura com varias threads a unir classes
+ *
+ * Faz compressao por halving com CAS: cada salto so e encurtado se ninguem o
+ * tiver alterado entretanto, e aponta sempre para um antecessor (parent[i] <= i).
+ *
+ * @param parent Tabela de equivalencias
+ * @param label Etiqueta provisoria
+ * @return int
+ */
+static int vc_uf_find_atomic(int* parent, int label)
+{
+    for (;;) {
+        const int p = vc_atomic_load(&parent[label]);
+        if (p == label) return label;
+
+        const int gp = vc_atomic_load(&parent[p]);
+        if (gp != p) vc_atomic_cas(&parent[label], p, gp);
+        label = p;
+    }
+}
+
+
+/**
+ * @brief Une as classes de duas etiquetas provisorias sem locks (a raiz fica a menor)
+ *
+ * @param parent Tabela de equivalencias
+ * @param a Etiqueta provisoria
+ * @param b Etiqueta provisoria
+ */
+static void vc_uf_union_atomic(int* parent, int a, int b)
+{
+    for (;;) {
+        a = vc_uf_find_atomic(parent, a);
+        b = vc_uf_find_atomic(parent, b);
+        if (a == b) return;
+
+        // Liga a raiz maior a menor; se entretanto deixou de ser raiz, tenta de novo
+        if (a < b) {
+            if (vc_atomic_cas(&parent[b], b, a)) return;
+        } else {
+            if (vc_atomic_cas(&parent[a], a, b)) return;
+        }
+    }
+}
+
+
+#define VC_LABEL_STRIPS_MAX 64 // Numero maximo de faixas na etiquetagem paralela
+
+
+/**
+ * @brief Etiquetagem provisoria de uma faixa de linhas (a linha acima da faixa e ignorada)
+ *
+ * @param src Imagem binaria de entrada
+ * @param labels Imagem de etiquetas
+ * @param parent Tabela de equivalencias
+ * @param y0 Primeira linha da faixa
+ * @param y1 Linha seguinte a ultima
+ * @param label Primeira etiqueta provisoria da faixa
+ * @return int Etiqueta seguinte a ultima usada
+ */
+static int vc_blob_label_strip(const IVC* src, int* labels, int* parent, const int y0, const int y1, int label)
+{
+    const int width = src->width;
+
+    // Kernel:
+    // A B C
+    // D X
+    for (int y = y0; y < y1; y++) {
+        const unsigned char* row = src->data + y * src->bytesperline;
+        int* lrow = labels + (long)y * width;
+        const int* lprev = (y > y0) ? lrow - width : NULL;
+
+        for (int x = 0; x < width; x++) {
+            if (row[x] == 0) {
+                lrow[x] = 0;
+                continue;
+            }
+
+            const int a = (y > y0 && x > 0) ? lprev[x - 1] : 0;
+            const int b = (y > y0) ? lprev[x] : 0;
+            const int c = (y > y0 && x < width - 1) ? lprev[x + 1] : 0;
+            const int d = (x > 0) ? lrow[x - 1] : 0;
+
+            // B e vizinho de A, C e D: basta herdar a sua etiqueta
+            if (b != 0) {
+                lrow[x] = b;
+            } else if (c != 0) {
+                if (a != 0) lrow[x] = vc_uf_union(parent, c, a);
+                else if (d != 0) lrow[x] = vc_uf_union(parent, c, d);
+                else lrow[x] = c;
+            } else if (a != 0) {
+                lrow[x] = a;
+            } else if (d != 0) {
+                lrow[x] = d;
+            } else {
+                parent[label] = label;
+                lrow[x] = label++;
+            }
+        }
+    }
+    return label;
+}
+
+
+/**
+ * @brief Etiquetagem de blobs com etiquetas de 32 bits (union-find)
+ *
+ * Etiquetagem em duas passagens com vizinhanca-8. A primeira atribui etiquetas
+ * provisorias e regista as equivalencias numa estrutura union-find; a segunda
+ * substitui cada etiqueta provisoria pela etiqueta final. Nao ha limite de
+ * etiquetas e o custo e linear no numero de pixeis.
+ * As etiquetas finais sao 1..nlabels, pela ordem de varrimento do primeiro
+ * pixel de cada blob; o fundo fica com 0. A segunda passagem preenche tambem
+ * a area, bounding box, centro de massa e perimetro de cada blob.
+ *
+ * @param src Imagem binaria de entrada (fundo = 0)
+ * @param labels Imagem de etiquetas de saida (width * height inteiros)
+ * @param nlabels Endereco de memoria de uma variavel, onde sera armazenado o numero de etiquetas encontradas.
+ * @return OVC*
+ */
+OVC* vc_binary_blob_labelling32(const IVC* src, int* labels, int* nlabels)
+{
+    const unsigned char* datasrc = src->data;
+    const int width = src->width;
+    const int height = src->height;
+    const int bytesperline = src->bytesperline;
+
+    *nlabels = 0;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || labels == NULL) return NULL;
+    if (src->channels != 1) return NULL;
+
+    // Uma faixa de linhas por thread, cada uma com o seu intervalo de etiquetas provisorias
+    // (limite com vizinhanca-8), por ordem de faixa: a ordem de varrimento mantem-se
+    const int nt = vc_kernel_threads(width, height);
+    const int nstrips = MIN(nt, VC_LABEL_STRIPS_MAX);
+    const int sband = (height + nstrips - 1) / nstrips;
+    int first[VC_LABEL_STRIPS_MAX + 1], next[VC_LABEL_STRIPS_MAX];
+
+    first[0] = 1;
+    for (int t = 0; t < nstrips; t++) {
+        const int rows = MAX(MIN(sband, height - t * sband), 0);
+        first[t + 1] = first[t] + ((width + 1) / 2) * ((rows + 1) / 2);
+    }
+
+    int* parent = malloc((size_t)first[nstrips] * sizeof(int));
+    if (parent == NULL) return NULL;
+    parent[0] = 0;
+
+    // Efetua a etiquetagem provisoria de cada faixa
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int t = 0; t < nstrips; t++) {
+        const int y0 = MIN(t * sband, height), y1 = MIN(y0 + sband, height);
+        next[t] = vc_blob_label_strip(src, labels, parent, y0, y1, first[t]);
+    }
+
+    // Une as classes que atravessam a fronteira entre faixas (a primeira linha de cada faixa com a anterior)
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int t = 1; t < nstrips; t++) {
+        const int y = t * sband;
+        if (y >= height) continue;
+
+        const int* lrow = labels + (long)y * width;
+        const int* lprev = lrow - width;
+
+        for (int x = 0; x < width; x++) {
+            if (lrow[x] == 0) continue;
+
+            for (int dx = MAX(x - 1, 0); dx <= MIN(x + 1, width - 1); dx++) {
+                if (lprev[dx] != 0) vc_uf_union_atomic(parent, lrow[x], lprev[dx]);
+            }
+        }
+    }
+
+    // Resolve as equivalencias e numera as etiquetas de forma compacta
+    for (int t = 0; t < nstrips; t++) {
+        for (int i = first[t]; i < next[t]; i++) {
+            if (parent[i] < i) parent[i] = parent[parent[i]];
+            else parent[i] = ++(*nlabels);
+        }
+    }
+
+    // Cada faixa acumula as caracteristicas por etiqueta provisoria, no seu proprio
+    // intervalo (first[t]..next[t]); as listas parciais ficam seguidas em part
+    int offset[VC_LABEL_STRIPS_MAX + 1];
+
+    offset[0] = 0;
+    for (int t = 0; t < nstrips; t++) offset[t + 1] = offset[t] + next[t] - first[t];
+
+    OVC* blobs = (*nlabels > 0) ? calloc((size_t)*nlabels, sizeof(OVC)) : NULL;
+    VC_BLOB_ACC* acc = (*nlabels > 0) ? malloc((size_t)*nlabels * sizeof(VC_BLOB_ACC)) : NULL;
+    OVC* part = (offset[nstrips] > 0) ? malloc((size_t)offset[nstrips] * sizeof(OVC)) : NULL;
+    VC_BLOB_ACC* pacc = (offset[nstrips] > 0) ? malloc((size_t)offset[nstrips] * sizeof(VC_BLOB_ACC)) : NULL;
+
+    if (blobs == NULL || acc == NULL || part == NULL || pacc == NULL) {
+        free(parent);
+        free(blobs);
+        free(acc);
+        free(part);
+        free(pacc);
+        *nlabels = 0;
+        return NULL;
+    }
+
+    // Volta a etiquetar a imagem e acumula as caracteristicas de cada etiqueta provisoria.
+    // Pixeis vizinhos-4 pertencem sempre ao mesmo blob, pelo que um pixel e de
+    // contorno se algum dos quatro vizinhos for fundo (ou estiver fora da imagem)
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int t = 0; t < nstrips; t++) {
+        const int y0 = MIN(t * sband, height), y1 = MIN(y0 + sband, height);
+
+        vc_blob_acc_init(part + offset[t], pacc + offset[t], next[t] - first[t], width, height);
+
+        for (int y = y0; y < y1; y++) {
+            const unsigned char* row = datasrc + y * bytesperline;
+            int* lrow = labels + (long)y * width;
+
+            for (int x = 0; x < width; x++) {
+                if (lrow[x] == 0) continue;
+
+                const int k = offset[t] + lrow[x] - first[t];
+                const int contour = x == 0 || x == width - 1 || y == 0 || y == height - 1
+                    || row[x - 1] == 0 || row[x + 1] == 0 || row[x - bytesperline] == 0 || row[x + bytesperline] == 0;
+
+                lrow[x] = parent[lrow[x]];
+                vc_blob_acc_add(&part[k], &pacc[k], x, y, contour);
+            }
+        }
+    }
+
+    // Soma cada etiqueta provisoria no blob final (parent[]); somas inteiras, minimos
+    // e maximos: o resultado nao depende do numero de faixas
+    vc_blob_acc_init(blobs, acc, *nlabels, width, height);
+    for (int i = 0; i < *nlabels; i++) blobs[i].label = i + 1;
+
+    for (int t = 0; t < nstrips; t++) {
+        for (int i = first[t]; i < next[t]; i++) {
+            const int k = offset[t] + i - first[t];
+            vc_blob_acc_merge(&blobs[parent[i] - 1], &acc[parent[i] - 1], &part[k], &pacc[k]);
+        }
+    }
+    vc_blob_acc_finish(blobs, acc, *nlabels);
+
+    free(parent);
+    free(acc);
+    free(part);
+    free(pacc);
+
+    return blobs;
+}
+
+
+/**
+ * @brief Informacao de blobs
+ *
+ * Calcula a area, bounding box, centro de massa e perimetro de todos os blobs
+ * numa unica passagem pela imagem de etiquetas.
+ *
+ * @param src Imagem de etiquetas (8 bits) de entrada
+ * @param blobs Lista de blobs
+ * @param nblobs Numero de blobs
+ * @return int
+ */
+int vc_binary_blob_info(const IVC* src, OVC* blobs, int nblobs)
+{
+    const unsigned char* data = src->data;
+    const int width = src->width;
+    const int height = src->height;
+    int bytesperline = src->bytesperline;
+    const int channels = src->channels;
+    int index[256];
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (channels != 1) return 0;
+
+    VC_BLOB_ACC* acc = malloc(MAX(nblobs, 1) * sizeof(VC_BLOB_ACC));
+    if (acc == NULL) return 0;
+
+    // Indice do blob de cada etiqueta
+    for (int i = 0; i < 256; i++) index[i] = -1;
+    for (int i = 0; i < nblobs; i++) index[blobs[i].label & 255] = i;
+    vc_blob_acc_init(blobs, acc, nblobs, width, height);
+
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 1; x < width - 1; x++) {
+            const long int pos = y * bytesperline + x * channels;
+            const unsigned char label = data[pos];
+
+            if (label == 0 || index[label] < 0) continue;
+
+            // Se pelo menos um dos quatro vizinhos nao pertence ao mesmo label, entao e um pixel de contorno
+            const int contour = data[pos - 1] != label
+                || data[pos + 1] != label
+                || data[pos - bytesperline] != label
+                || data[pos + bytesperline] != label;
+
+            vc_blob_acc_add(&blobs[index[label]], &acc[index[label]], x, y, contour);
+        }
+    }
+    vc_blob_acc_finish(blobs, acc, nblobs);
+
+    free(acc);
+    return 1;
+}
+
+
+/**
+ * @brief Informacao de blobs a partir de uma imagem de etiquetas de 32 bits
+ *
+ * Calcula as caracteristicas de todos os blobs numa unica passagem. As etiquetas
+ * devem ser compactas (1..nblobs), como as de vc_binary_blob_labelling32().
+ *
+ * @param labels Imagem de etiquetas (width * height inteiros)
+ * @param width Largura
+ * @param height Altura
+ * @param blobs Lista de blobs (blobs[i] corresponde a etiqueta i + 1)
+ * @param nblobs Numero de blobs
+ * @return int
+ */
+int vc_binary_blob_info32(const int* labels, const int width, const int height, OVC* blobs, int nblobs)
+{
+    if (labels == NULL || width <= 0 || height <= 0 || blobs == NULL) return 0;
+
+    VC_BLOB_ACC* acc = malloc(MAX(nblobs, 1) * sizeof(VC_BLOB_ACC));
+    if (acc == NULL) return 0;
+
+    vc_blob_acc_init(blobs, acc, nblobs, width, height);
+
+    for (int y = 0; y < height; y++) {
+        const int* row = labels + (long)y * width;
+
+        for (int x = 0; x < width; x++) {
+            const int label = row[x];
+
+            if (label <= 0 || label > nblobs) continue;
+
+            const int contour = x == 0 || x == width - 1 || y == 0 || y == height - 1
+                || row[x - 1] != label || row[x + 1] != label || row[x - width] != label || row[x + width] != label;
+
+            blobs[label - 1].label = label;
+            vc_blob_acc_add(&blobs[label - 1], &acc[label - 1], x, y, contour);
+        }
+    }
+    vc_blob_acc_finish(blobs, acc, nblobs);
+
+    free(acc);
+    return 1;
+}
+
+
+/**
+ * @brief Calcula e identifica bounding box
+ *
+ * @param x Coordenada x
+ * @param y Coordenada y
+ * @param largura Largura
+ * @param altura Altura
+ * @param isaida Imagem de saida
+ * @return int
+ */
+int vc_draw_bounding_box(const int x, const int y, int largura, int altura, const IVC* isaida)
+{
+    unsigned char* datadst = isaida->data;
+    int bytesperline_dst = isaida->bytesperline;
+    const int channels_dst = isaida->channels;
+    int width_dst = isaida->width;
+    int height_dst = isaida->height;
+    long int pos;
+
+    for (int i = x; i < x + largura; i++) {
+        pos = y * bytesperline_dst + i * channels_dst;
+        datadst[pos] = 0;
+        datadst[pos + 1] = 0;
+        datadst[pos + 2] = 0;
+
+        pos = (y + altura) * bytesperline_dst + i * channels_dst;
+        datadst[pos] = 0;
+        datadst[pos + 1] = 0;
+        datadst[pos + 2] = 0;
+    }
+
+    for (int i = y; i < y + altura; i++) {
+        pos = i * bytesperline_dst + x * channels_dst;
+        datadst[pos] = 0;
+        datadst[pos + 1] = 0;
+        datadst[pos + 2] = 0;
+
+        pos = i * bytesperline_dst + (x + largura) * channels_dst;
+        datadst[pos] = 0;
+        datadst[pos + 1] = 0;
+        datadst[pos + 2] = 0;
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Calcula e identifica centro da imagem
+ *
+ * @param x Coordenada x
+ * @param y Coordenada y
+ * @param xc Coordenada x do centro
+ * @param yc Coordenada y do centro
+ * @param largura Largura
+ * @param altura Altura
+ * @param isaida Imagem de saida
+ * @return int
+ */
+int vc_center_of_mass(const int x, const int y, const int xc, const int yc, int largura, int altura, const IVC* isaida)
+{
+    unsigned char* datadst = isaida->data;
+    int bytesperline_dst = isaida->bytesperline;
+    const int channels_dst = isaida->channels;
+    const int width_dst = isaida->width;
+    const int height_dst = isaida->height;
+
+    // Limites para evitar estouro de memoria
+    for (int i = x; i < x + largura; i++) {
+        for (int j = y; j < y + altura; j++) {
+            if (xc == i && yc == j) {
+                if (i >= 0 && i < width_dst && j >= 0 && j < height_dst) {
+                    long int pos = j * bytesperline_dst + i * channels_dst;
+                    datadst[pos] = 0;
+                    datadst[pos + 1] = 0;
+                    datadst[pos + 2] = 0;
+
+                    for (int k = 1; k < 6; k++) {
+                        // Verificacao para os limites superiores e inferiores ao centro de massa
+                        if (j - k >= 0 && j - k < height_dst) {
+                            pos = (j - k) * bytesperline_dst + i * channels_dst;
+                            datadst[pos] = 0;
+                            datadst[pos + 1] = 0;
+                            datadst[pos + 2] = 0;
+                        }
+
+                        if (j + k >= 0 && j + k < height_dst) {
+                            pos = (j + k) * bytesperline_dst + i * channels_dst;
+                            datadst[pos] = 0;
+                            datadst[pos + 1] = 0;
+                            datadst[pos + 2] = 0;
+                        }
+
+                        // Verificacao para os limites a esquerda e a direita do centro de massa
+                        if (i + k >= 0 && i + k < width_dst) {
+                            pos = j * bytesperline_dst + (i + k) * channels_dst;
+                            datadst[pos] = 0;
+                            datadst[pos + 1] = 0;
+                            datadst[pos + 2] = 0;
+                        }
+
+                        if (i - k >= 0 && i - k < width_dst) {
+                            pos = j * bytesperline_dst + (i - k) * channels_dst;
+                            datadst[pos] = 0;
+                            datadst[pos + 1] = 0;
+                            datadst[pos + 2] = 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Conta pixels brancos da imagem
+ *
+ * @param image Imagem de entrada
+ * @return int
+ */
+int countWhitePixels(const IVC* image) {
+    int count = 0;
+    const int bytesPerLine = image->bytesperline;
+
+    for (int y = 0; y < image->height; y++) {
+        for (int x = 0; x < image->width; x++) {
+            const long int pos = y * bytesPerLine + x * image->channels;
+            if (image->data[pos] == 255) count++;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * @brief Verifica a cor predominante da imagem
+ *
+ * @param image Imagem de entrada
+ * @return int
+ */
+int colors_check(const IVC* image)
+{
+    const IVC* imageRED = vc_image_new(image->width, image->height, 3, image->levels);
+    const IVC* imageBLUE = vc_image_new(image->width, image->height, 3, image->levels);
+    int countRed = 0;
+    int countBlue = 0;
+    int aux = -1;
+
+    vc_hsv_segmentation(image, imageRED, 240, 255, 17, 100, 20, 100);
+
+    countRed = countWhitePixels(imageRED);
+
+    vc_hsv_segmentation(image, imageRED, 0, 15, 17, 100, 20, 100);
+    countRed += countWhitePixels(imageRED);
+    printf("Count Red: %d\n", countRed);
+
+    vc_hsv_segmentation(image, imageBLUE, 15, 60, 40, 100, 10, 100);
+
+    countBlue = countWhitePixels(imageBLUE);
+    printf("Count Blue: %d\n", countBlue);
+
+    if (countRed > countBlue && countRed > 1000) {
+        aux = 0;  // Vermelho
+    } else if (countBlue > countRed && countBlue > 500) {
+        aux = 1;  // Azul
+    }
+
+    return aux;
+}
+
+
+/**
+ * @brief Calcula a redondeza da imagem
+ *
+ * @param binaryImage Imagem binaria de entrada
+ * @return float
+ */
+float vc_calculate_roundness(const IVC* binaryImage)
+{
+    const unsigned char* data = (unsigned char*)binaryImage->data;
+    int bytesperline = binaryImage->bytesperline;
+    const int channels = binaryImage->channels;
+    const int width = binaryImage->width;
+    const int height = binaryImage->height;
+    int area = 0;
+    int perimeter = 0;
+
+    // Itera sobre todos os pixeis da imagem
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const long int pos = y * bytesperline + x * channels;
+
+            // Se o pixel faz parte do objeto (diferente de zero), incrementa a area
+            if (data[pos] != 0) {
+                area++;
+
+                // Verifica se o pixel faz parte do contorno do objeto
+                if (x > 0 && data[pos - channels] == 0
+                    || x < width - 1 && data[pos + channels] == 0
+                    || y > 0 && data[pos - bytesperline] == 0
+                    || y < height - 1 && data[pos + bytesperline] == 0
+                    ) {
+                    perimeter++;
+                }
+            }
+        }
+    }
+    if (perimeter == 0) return 0;  // Evita divisao por zero
+    const float roundness = 4 * M_PI * area / (float)(perimeter * perimeter);
+
+    return roundness;
+}
+
+
+/**
+ * @brief Verifica se a imagem e um circulo
+ *
+ * @param image Imagem de entrada
+ * @return int
+ */
+int vc_stop_forbiden_distinction(const IVC* image)
+{
+    const float roundness = vc_calculate_roundness(image);
+    int aux = -1;
+
+    printf("Roundness: %f\n", roundness);
+
+    // caso se verifique que a roundness o maior que 0.15 o Sentido Proibido
+    if (roundness >= 0.15) {
+        aux = 1;
+    } else if (roundness < 0.15) { // Se for menor que 0.15, o STOP
+        aux = 0;
+    }
+
+    return aux;
+}
+
+
+/**
+ * @brief Verifica a cor predominante da imagem
+ *
+ * @param image Imagem de entrada
+ * @param xbb Coordenada x da bounding box
+ * @param ybb Coordenada y da bounding box
+ * @param widthbb Largura da bounding box
+ * @param heightbb Altura da bounding box
+ * @return int
+ */
+int vc_arrows_distinction(const IVC* image, const int xbb, const int ybb, int widthbb, int heightbb)
+{
+    const unsigned char* data = (unsigned char*)image->data;
+    int bytesperline = image->bytesperline;
+    const int height = image->height;
+    const int width = image->width;
+    int countLeft = 0;
+    int countRight = 0;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const long int pos = y * bytesperline + x * image->channels;
+
+            if (x >= xbb && x <= xbb + widthbb && (y >= ybb && y <= ybb + heightbb)) { // Dentro da bounding box
+                if (x < xbb + widthbb / 2) {
+                    if (data[pos] == 0) countLeft++;
+                } else {
+                    if (data[pos] == 0) countRight++;
+                }
+            }
+        }
+    }
+
+    printf("Count Left: %d\n", countLeft);
+    printf("Count Right: %d\n", countRight);
+
+    if (countLeft > countRight) return 1;
+    return 2;
+}
+
+
+/**
+ * @brief Get token
+ *
+ * @param file Ficheiro
+ * @param tok
+ * @param len
+ * @return char*
+ */
+char* netpbm_get_token(FILE* file, char* tok, const int len)
+{
+    int c;
+
+    for (;;) {
+        while (isspace(c = getc(file)))
+            ;
+        if (c != '#') break;
+        do c = getc(file);
+        while (c != '\n' && c != EOF);
+        if (c == EOF) break;
+    }
+
+    char* t = tok;
+
+    if (c != EOF) {
+        do {
+            *t++ = c;
+            c = getc(file);
+        } while (!isspace(c) && c != '#' && c != EOF && t - tok < len - 1);
+
+        if (c == '#') ungetc(c, file);
+    }
+    *t = 0;
+
+    return tok;
+}
+
+
+// Inverte a ordem dos bits de um byte (movemask poe o primeiro pixel no bit 0; o PBM no bit 7)
+static unsigned char vc_bit_reverse8(unsigned char b)
+{
+    b = (unsigned char)((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+    b = (unsigned char)((b & 0xCC) >> 2 | (b & 0x33) << 2);
+    return (unsigned char)((b & 0xAA) >> 1 | (b & 0x55) << 1);
+}
+
+
+/**
+ * @brief Compacta uma linha de pixeis em bits PBM (pixel 0 = bit 1 = preto)
+ *
+ * @param src Pixeis da linha
+ * @param dst Bytes PBM da linha ((width + 7) / 8)
+ * @param width Largura
+ * @return long int
+ */
+static long int vc_pbm_pack_row(const unsigned char* src, unsigned char* dst, const int width)
+{
+    unsigned char* p = dst;
+    int x = 0;
+
+#if defined(VC_SIMD_AVX2)
+    const __m256i zero32 = _mm256_setzero_si256();
+    for (; x + 32 <= width; x += 32) {
+        const unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src + x)), zero32));
+        for (int k = 0; k < 4; k++) *p++ = vc_bit_reverse8((unsigned char)(m >> (8 * k)));
+    }
+#endif
+#if defined(VC_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        const int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + x)), zero));
+        *p++ = vc_bit_reverse8((unsigned char)m);
+        *p++ = vc_bit_reverse8((unsigned char)(m >> 8));
+    }
+#endif
+    for (; x < width; x += 8) {
+        const int n = MIN(8, width - x);
+        unsigned char b = 0;
+
+        for (int k = 0; k < n; k++) b |= (unsigned char)((src[x + k] == 0) << (7 - k));
+        *p++ = b;
+    }
+    return (long int)(p - dst);
+}
+
+
+/**
+ * @brief Descompacta uma linha de bits PBM em pixeis (bit 1 = preto = 0; bit 0 = branco = 1)
+ *
+ * @param src Bytes PBM da linha
+ * @param dst Pixeis da linha
+ * @param width Largura
+ */
+static void vc_pbm_unpack_row(const unsigned char* src, unsigned char* dst, const int width)
+{
+    int x = 0;
+
+#if defined(VC_SIMD_SSE2)
+    // Cada byte PBM e replicado por 8 pistas; cada pista testa o seu bit (do mais significativo para o menos)
+    const __m128i bits = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                                       (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; x + 16 <= width; x += 16) {
+        __m128i v = _mm_cvtsi32_si128(src[x >> 3] | src[(x >> 3) + 1] << 8);
+        v = _mm_unpacklo_epi8(v, v);
+        v = _mm_unpacklo_epi16(v, v);
+        v = _mm_unpacklo_epi32(v, v);
+
+        const __m128i set = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_andnot_si128(set, one));
+    }
+#endif
+    for (; x < width; x++) dst[x] = (src[x >> 3] >> (7 - (x & 7)) & 1) ? 0 : 1;
+}
+
+
+/**
+ * @brief Converte unsigned char para bit
+ *
+ * Numa imagem PBM 1 = preto e 0 = branco; na nossa imagem 1 = branco e 0 = preto.
+ * Cada linha comeca num byte novo.
+ *
+ * @param datauchar
+ * @param databit
+ * @param width Largura
+ * @param height Altura
+ * @return long int
+ */
+long int unsigned_char_to_bit(const unsigned char* datauchar, unsigned char* databit, const int width, const int height)
+{
+    long int counttotalbytes = 0;
+
+    for (int y = 0; y < height; y++)
+        counttotalbytes += vc_pbm_pack_row(datauchar + (size_t)y * width, databit + counttotalbytes, width);
+
+    return counttotalbytes;
+}
+
+
+/**
+ * @brief Converte bit para unsigned char
+ *
+ * @param databit
+ * @param datauchar
+ * @param width Largura
+ * @param height Altura
+ */
+void bit_to_unsigned_char(const unsigned char* databit, unsigned char* datauchar, const int width, const int height)
+{
+    const size_t rowbytes = (size_t)(width + 7) / 8;
+
+    for (int y = 0; y < height; y++)
+        vc_pbm_unpack_row(databit + y * rowbytes, datauchar + (size_t)y * width, width);
+}
+
+
+/**
+ * @brief Le imagem
+ *
+ * O ficheiro e projetado em memoria (vc_image_map) e os pixeis sao copiados para uma imagem nova.
+ *
+ * @param filename Nome do ficheiro
+ * @return IVC*
+ */
+IVC* vc_read_image(const char* filename)
+{
+    MVC* map = vc_image_map(filename);
+    if (map == NULL) return NULL;
+
+    IVC* image = vc_image_new(map->image.width, map->image.height, map->image.channels, map->image.levels);
+
+    if (image != NULL) {
+        const size_t rowbytes = (size_t)image->width * image->channels;
+
+        for (int y = 0; y < image->height; y++)
+            memcpy(image->data + y * rowbytes, map->image.data + (size_t)y * map->image.bytesperline, rowbytes);
+    }
+
+    vc_image_unmap(map);
+    return image;
+}
+
+
+/**
+ * @brief Escreve imagem
+ *
+ * @param filename Nome do ficheiro
+ * @param image Imagem
+ * @return int
+ */
+int vc_write_image(const char* filename, const IVC* image)
+{
+    FILE* file = NULL;
+
+    if (image == NULL) return 0;
+
+    if ((file = fopen(filename, "wb")) != NULL) {
+        if (image->levels == 1) {
+            long int sizeofbinarydata = (image->width / 8 + (image->width % 8 ? 1 : 0)) * image->height + 1;
+            unsigned char* tmp = malloc(sizeofbinarydata);
+
+            if (tmp == NULL) return 0;
+            fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
+
+            // Linha a linha, para respeitar o bytesperline de uma vista
+            long int totalbytes = 0;
+            for (int y = 0; y < image->height; y++)
+                totalbytes += vc_pbm_pack_row(image->data + (size_t)y * image->bytesperline, tmp + totalbytes, image->width);
+            if (fwrite(tmp, sizeof(unsigned char), totalbytes, file) != totalbytes) {
+#ifdef VC_DEBUG
+                fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
+#endif
+
+                fclose(file);
+                free(tmp);
+                return 0;
+            }
+            free(tmp);
+        } else {
+            fprintf(file, "%s %d %d 255\n", (image->channels == 1) ? "P5" : "P6", image->width, image->height);
+
+            const size_t rowbytes = (size_t)image->width * image->channels;
+            int written = 0;
+
+            // Uma imagem contigua sai de uma vez; uma vista sai linha a linha
+            if ((size_t)image->bytesperline == rowbytes) {
+                written = fwrite(image->data, rowbytes, image->height, file) == (size_t)image->height;
+            } else {
+                int y = 0;
+                while (y < image->height && fwrite(image->data + (size_t)y * image->bytesperline, 1, rowbytes, file) == rowbytes) y++;
+                written = y == image->height;
+            }
+
+            if (!written) {
+#ifdef VC_DEBUG
+                fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
+#endif
+
+                fclose(file);
+                return 0;
+            }
+        }
+        fclose(file);
+        return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Le um numero do cabecalho PNM (ignora espacos e comentarios)
+ *
+ * @param p Posicao atual
+ * @param end Fim do ficheiro
+ * @param value Numero lido
+ * @return const unsigned char* (posicao a seguir ao numero; NULL se nao houver numero)
+ */
+static const unsigned char* vc_pnm_number(const unsigned char* p, const unsigned char* end, int* value)
+{
+    for (;;) {
+        while (p < end && isspace(*p)) p++;
+        if (p == end || *p != '#') break;
+        while (p < end && *p != '\n') p++;
+    }
+
+    if (p == end || !isdigit(*p)) return NULL;
+
+    long v = 0;
+    while (p < end && isdigit(*p) && v <= INT_MAX / 10) v = v * 10 + (*p++ - '0');
+    if (v > INT_MAX || (p < end && isdigit(*p))) return NULL;
+
+    *value = (int)v;
+    return p;
+}
+
+
+/**
+ * @brief Le o cabecalho de um ficheiro PBM (P4), PGM (P5) ou PPM (P6) em memoria
+ *
+ * @param data Inicio do ficheiro
+ * @param size Tamanho do ficheiro
+ * @param image Imagem a preencher (dimensoes, canais e niveis; sem dados)
+ * @return size_t (inicio dos pixeis; 0 se o cabecalho for invalido ou o ficheiro curto)
+ */
+static size_t vc_pnm_header(const unsigned char* data, const size_t size, IVC* image)
+{
+    const unsigned char* end = data + size;
+    const unsigned char* p = data + 2;
+    int width, height, levels = 1;
+
+    if (size < 3 || data[0] != 'P' || data[1] < '4' || data[1] > '6') return 0;
+
+    if ((p = vc_pnm_number(p, end, &width)) == NULL || (p = vc_pnm_number(p, end, &height)) == NULL) return 0;
+    if (data[1] != '4' && (p = vc_pnm_number(p, end, &levels)) == NULL) return 0;
+    if (width <= 0 || height <= 0 || levels <= 0 || levels > 255) return 0;
+    if (p == end || !isspace(*p)) return 0;
+    p++; // Um unico espaco separa o cabecalho dos pixeis
+
+    image->width = width;
+    image->height = height;
+    image->channels = data[1] == '6' ? 3 : 1;
+    image->levels = levels;
+    image->bytesperline = width * image->channels;
+
+    const size_t rowbytes = data[1] == '4' ? (size_t)(width + 7) / 8 : (size_t)image->bytesperline;
+    if ((size_t)(end - p) / height < rowbytes) return 0;
+
+    return (size_t)(p - data);
+}
+
+
+/**
+ * @brief Liberta a projecao de um ficheiro (sem libertar a estrutura)
+ *
+ * @param map Imagem projetada
+ */
+static void vc_image_map_release(MVC* map)
+{
+#ifdef VC_HAVE_MMAP
+    if (map->base != NULL) munmap(map->base, map->size);
+#else
+    if (map->handle != NULL) {
+        fwrite(map->base, 1, map->size, (FILE*)map->handle);
+        fclose((FILE*)map->handle);
+    }
+    free(map->base);
+#endif
+    if (map->image.owndata) free(map->image.data);
+    free(map);
+}
+
+
+/**
+ * @brief Projeta um ficheiro PBM, PGM ou PPM em memoria
+ *
+ * Em PGM e PPM, image e uma vista sobre os pixeis do proprio ficheiro (nao ha copia nem
+ * leitura antecipada: as paginas sao lidas quando acedidas). Alterar os pixeis nao altera o
+ * ficheiro. Em PBM os bits sao descompactados para uma imagem propria.
+ * Sem mmap (fora de sistemas POSIX), o ficheiro e lido para memoria de uma so vez.
+ *
+ * @param filename Nome do ficheiro
+ * @return MVC* (libertar com vc_image_unmap)
+ */
+MVC* vc_image_map(const char* filename)
+{
+    MVC* map = calloc(1, sizeof(MVC));
+    if (map == NULL) return NULL;
+
+#ifdef VC_HAVE_MMAP
+    const int fd = open(filename, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        if (fd >= 0) close(fd);
+        free(map);
+        return NULL;
+    }
+
+    // Privada e com escrita: os kernels podem alterar a imagem no local sem tocar no ficheiro
+    map->size = (size_t)st.st_size;
+    map->base = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map->base == MAP_FAILED) {
+        free(map);
+        return NULL;
+    }
+#else
+    FILE* file = fopen(filename, "rb");
+    long size;
+
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) <= 0 || fseek(file, 0, SEEK_SET) != 0 ||
+        (map->base = malloc((size_t)size)) == NULL || fread(map->base, 1, (size_t)size, file) != (size_t)size) {
+        if (file != NULL) fclose(file);
+        vc_image_map_release(map);
+        return NULL;
+    }
+    map->size = (size_t)size;
+    fclose(file);
+#endif
+
+    map->offset = vc_pnm_header(map->base, map->size, &map->image);
+    if (map->offset == 0) {
+#ifdef VC_DEBUG
+        printf("ERROR -> vc_image_map():\n\tFile is not a valid PBM, PGM or PPM file.\n");
+#endif
+        vc_image_map_release(map);
+        return NULL;
+    }
+
+    if (map->image.levels == 1 && map->base[1] == '4') {
+        map->image.data = malloc((size_t)map->image.width * map->image.height);
+        if (map->image.data == NULL) {
+            vc_image_map_release(map);
+            return NULL;
+        }
+        map->image.owndata = 1;
+        bit_to_unsigned_char(map->base + map->offset, map->image.data, map->image.width, map->image.height);
+    } else {
+        map->image.data = map->base + map->offset;
+    }
+
+    return map;
+}
+
+
+/**
+ * @brief Cria um ficheiro PBM, PGM ou PPM com o tamanho final e projeta-o em memoria
+ *
+ * Em PGM e PPM, image e uma vista sobre os pixeis do ficheiro: o que for escrito na imagem
+ * fica no ficheiro, sem copias. Em PBM (levels = 1) a imagem e propria e os bits sao
+ * compactados para o ficheiro em vc_image_unmap.
+ *
+ * @param filename Nome do ficheiro
+ * @param width Largura
+ * @param height Altura
+ * @param channels Canais (1 ou 3)
+ * @param levels Niveis (1 = PBM)
+ * @return MVC* (libertar com vc_image_unmap, que conclui a escrita)
+ */
+MVC* vc_image_map_create(const char* filename, const int width, const int height, const int channels, const int levels)
+{
+    if (width <= 0 || height <= 0 || levels <= 0 || levels > 255) return NULL;
+    if (channels != 1 && channels != 3) return NULL;
+    if (levels == 1 && channels != 1) return NULL;
+
+    char header[64];
+    const int pbm = levels == 1;
+    const int hlen = pbm ? snprintf(header, sizeof(header), "P4 %d %d\n", width, height)
+                         : snprintf(header, sizeof(header), "%s %d %d %d\n", channels == 1 ? "P5" : "P6", width, height, levels);
+    const size_t rowbytes = pbm ? (size_t)(width + 7) / 8 : (size_t)width * channels;
+
+    MVC* map = calloc(1, sizeof(MVC));
+    if (map == NULL) return NULL;
+
+    map->size = (size_t)hlen + rowbytes * height;
+    map->offset = (size_t)hlen;
+    map->writable = 1;
+
+#ifdef VC_HAVE_MMAP
+    const int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0 || ftruncate(fd, (off_t)map->size) != 0) {
+        if (fd >= 0) close(fd);
+        free(map);
+        return NULL;
+    }
+
+    map->base = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map->base == MAP_FAILED) {
+        free(map);
+        return NULL;
+    }
+#else
+    if ((map->base = calloc(map->size, 1)) == NULL || (map->handle = fopen(filename, "wb")) == NULL) {
+        vc_image_map_release(map);
+        return NULL;
+    }
+#endif
+
+    memcpy(map->base, header, (size_t)hlen);
+
+    map->image.width = width;
+    map->image.height = height;
+    map->image.channels = channels;
+    map->image.levels = levels;
+    map->image.bytesperline = width * channels;
+
+    if (pbm) {
+        map->image.data = calloc((size_t)width * height, 1);
+        if (map->image.data == NULL) {
+            vc_image_map_release(map);
+            return NULL;
+        }
+        map->image.owndata = 1;
+    } else {
+        map->image.data = map->base + map->offset;
+    }
+
+    return map;
+}
+
+
+/**
+ * @brief Liberta uma imagem projetada (num ficheiro criado, conclui a escrita)
+ *
+ * @param map Imagem projetada
+ * @return MVC*
+ */
+MVC* vc_image_unmap(MVC* map)
+{
+    if (map == NULL) return NULL;
+
+    // PBM: compacta a imagem para os bits do ficheiro
+    if (map->writable && map->image.owndata) {
+        const size_t rowbytes = (size_t)(map->image.width + 7) / 8;
+
+        for (int y = 0; y < map->image.height; y++)
+            vc_pbm_pack_row(map->image.data + (size_t)y * map->image.bytesperline, map->base + map->offset + y * rowbytes, map->image.width);
+    }
+
+    vc_image_map_release(map);
+    return NULL;
+}
+
+
+/**
+ * @brief Converte imagem para grayscale
+ *
+ * @param srcdst
+ * @return int
+ */
+int vc_gray_negative(const IVC* srcdst)
+{
+    if (srcdst != NULL) {
+        // Validacao de erros
+        if (srcdst->channels != 1 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+
+        for (int y = 0; y < srcdst->height; y++) {
+            for (int x = 0; x < srcdst->width; x++) {
+                //calcular a posicao do byte na posicao do pixel
+                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+                srcdst->data[pos] = 255 - srcdst->data[pos];
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Converte imagem para grayscale
+ *
+ * @param srcdst
+ * @return int
+ */
+int vc_rgb_negative(const IVC* srcdst)
+{
+    if (srcdst != NULL) {
+        // Validacao de erros
+        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+
+        for (int y = 0; y < srcdst->height; y++) {
+            for (int x = 0; x < srcdst->width; x++) {
+                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+
+                srcdst->data[pos] = 255 - srcdst->data[pos];
+                srcdst->data[pos + 1] = 255 - srcdst->data[pos + 1];
+                srcdst->data[pos + 2] = 255 - srcdst->data[pos + 2];
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Converte imagem para grayscale
+ *
+ * @param srcdst
+ * @return int
+ */
+int vc_rgb_get_red_gray(const IVC* srcdst)
+{
+    if (srcdst != NULL) {
+        // Validacao de erros
+        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+
+        for (int y = 0; y < srcdst->height; y++) {
+            for (int x = 0; x < srcdst->width; x++) {
+                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+
+                //se fosse obter apenas o vermelho basta apenas colocar a 0 o valor do verde e azul
+                srcdst->data[pos + 1] = srcdst->data[pos]; //verde
+                srcdst->data[pos + 2] = srcdst->data[pos]; //azul
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Converte imagem para grayscale
+ *
+ * @param srcdst
+ * @return int
+ */
+int vc_rgb_get_green_gray(const IVC* srcdst)
+{
+    if (srcdst != NULL) {
+        // Validacao de erros
+        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+
+        for (int y = 0; y < srcdst->height; y++) {
+            for (int x = 0; x < srcdst->width; x++) {
+                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+
+                //se fosse obter apenas o verde basta apenas colocar a 0 o valor do vermelho e azul
+                srcdst->data[pos] = srcdst->data[pos + 1];	   //vermelho
+                srcdst->data[pos + 2] = srcdst->data[pos + 1]; //azul
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Converte imagem para grayscale
+ *
+ * @param srcdst
+ * @return int
+ */
+int vc_rgb_get_blue_gray(const IVC* srcdst)
+{
+    if (srcdst != NULL) {
+        // Validacao de erros
+        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+
+        for (int y = 0; y < srcdst->height; y++) {
+            for (int x = 0; x < srcdst->width; x++) {
+                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+
+                //se fosse obter apenas o verde basta apenas colocar a 0 o valor do vermelho e azul
+                srcdst->data[pos] = srcdst->data[pos + 2];	   //vermelho
+                srcdst->data[pos + 1] = srcdst->data[pos + 2]; //verde
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Converte imagem de grayscale para RGB
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
+ */
+int vc_scale_gray_to_rgb(const IVC* src, const IVC* dst)
+{
+    unsigned char* datasrc = src->data;
+    int bytesperline_src = src->bytesperline;
+    unsigned char* datadst = dst->data;
+    const int height = src->height;
+    int d, i;
+    unsigned char red[256], green[256], blue[256];
+
+    for (d = 0, i = 0; i < 64; i++, d += 4) {
+        red[i] = 0;
+        green[i] = d;
+        blue[i] = 255;
+    }
+
+    for (d = 255, i = 64; i < 128; i++, d -= 4) {
+        red[i] = 0;
+        green[i] = 255;
+        blue[i] = d;
+    }
+
+    for (d = 0, i = 128; i < 192; i++, d += 4) {
+        red[i] = d;
+        green[i] = 255;
+        blue[i] = 0;
+    }
+
+    for (d = 255, i = 192; i < 256; i++, d -= 4) {
+        red[i] = 255;
+        green[i] = d;
+        blue[i] = 0;
+    }
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char* in = datasrc + y * bytesperline_src;
+        unsigned char* out = datadst + y * dst->bytesperline;
+
+        for (int x = 0; x < src->width; x++, out += 3) {
+            const unsigned char brilho = in[x];
+            out[0] = red[brilho];
+            out[1] = green[brilho];
+            out[2] = blue[brilho];
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * @brief Binariza por comparacao com um limiar (v >= threshold -> on, restantes -> 255 - on)
+ *
+ * @param src Imagem de entrada (1 canal)
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param threshold Limiar
+ * @param on Valor dos pixeis >= threshold (0 ou 255)
+ */
+static void vc_threshold_ge(const IVC* src, const IVC* dst, const int threshold, const unsigned char on)
+{
+    const unsigned char t = (unsigned char)MIN(MAX(threshold, 0), 255);
+    const unsigned char flip = on ? 0 : 255;
+    const int nt = vc_kernel_threads(src->width, src->height);
+
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < src->height; y++) {
+        const unsigned char* row = src->data + y * src->bytesperline;
+        unsigned char* out = dst->data + y * dst->bytesperline;
+        int x = 0;
+
+        if (threshold > 255) {
+            memset(out, 255 - on, src->width);
+            continue;
+        }
+
+#ifdef VC_SIMD_SSE2
+        const __m128i vt = _mm_set1_epi8((char)t);
+        const __m128i vf = _mm_set1_epi8((char)flip);
+        for (; x + 16 <= src->width; x += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+            const __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, vt), v);
+            _mm_storeu_si128((__m128i*)(out + x), _mm_xor_si128(ge, vf));
+        }
+#endif
+
+        for (; x < src->width; x++) out[x] = (row[x] >= t ? 255 : 0) ^ flip;
+    }
+}
+
+
+/**
+ * @brief Converte imagem de grayscale para binario
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param threshold Limiar
+ * @return int
+ */
+int vc_gray_to_binary(const IVC* src, const IVC* dst, const int threshold)
+{
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (src->levels != 255 || src->channels != 1 || dst->channels != 1) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+
+    // Pixeis abaixo do limiar ficam a 255
+    vc_threshold_ge(src, dst, threshold, 0);
+    return 1;
+}
+
+
+/**
+ * @brief Converte imagem de grayscale para binario
+ *
+ * @param srcdst
+ * @return int
+ */
+int vc_gray_to_binary_global_mean(const IVC* srcdst)
+{
+    if (srcdst != NULL) {
+        int x, y;
+        long int pos, sum = 0, average = 0;
+
+        // Validacao de erros
+        if (srcdst->channels != 1 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+
+        for (y = 0; y < srcdst->height; y++) {
+            for (x = 0; x < srcdst->width; x++) {
+                pos = y * srcdst->bytesperline + x * srcdst->channels;
+                sum += srcdst->data[pos];
+            }
+        }
+
+        average = sum / (srcdst->width * srcdst->height);
+
+        for (y = 0; y < srcdst->height; y++) {
+            for (x = 0; x < srcdst->width; x++) {
+                pos = y * srcdst->bytesperline + x * srcdst->channels;
+                if (srcdst->data[pos] > average) srcdst->data[pos] = 255;
+                else srcdst->data[pos] = 0;
+            }
+        }
+    }
+    return 1;
+}
+
+
+#define VC_MORPH_STRIP 64 // Colunas processadas em simultaneo na passagem vertical
+
+
+/**
+ * @brief Maximo deslizante de uma faixa de linhas paralelas (van Herk / Gil-Werman)
+ *
+ * Cada uma das cols linhas da faixa e estendida com zeros e dividida em blocos de
+ * k elementos; em cada bloco calcula-se o maximo acumulado para a frente (g) e
+ * para tras (h). O maximo de qualquer janela de k elementos e max(h[inicio], g[fim]),
+ * pelo que o custo por pixel nao depende de k. As linhas da faixa sao processadas
+ * lado a lado (VC_MORPH_STRIP de cada vez), o que permite vetorizar os ciclos.
+ * Com flip = 255 os valores sao invertidos a entrada e a saida, obtendo-se o
+ * minimo (fora da imagem conta como 255).
+ *
+ * O elemento i da linha c esta em data[i * step + c * cross], tanto para linhas
+ * horizontais (step = 1, cross = bytesperline) como verticais (o inverso).
+ *
+ * @param src Imagem de entrada
+ * @param srcstep Distancia entre elementos consecutivos de uma linha (entrada)
+ * @param srccross Distancia entre linhas consecutivas da faixa (entrada)
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param dststep Distancia entre elementos consecutivos de uma linha (saida)
+ * @param dstcross Distancia entre linhas consecutivas da faixa (saida)
+ * @param n Numero de elementos por linha
+ * @param cols Numero de linhas da faixa (ate VC_MORPH_STRIP)
+ * @param k Tamanho da janela
+ * @param flip 0 para maximo, 255 para minimo
+ * @param e Memoria temporaria ((n + 2k) * VC_MORPH_STRIP elementos)
+ * @param g Memoria temporaria ((n + 2k) * VC_MORPH_STRIP elementos)
+ * @param h Memoria temporaria ((n + 2k) * VC_MORPH_STRIP elementos)
+ */
+static void vc_vhgw_strip(const unsigned char* src, const long srcstep, const long srccross,
+                          unsigned char* dst, const long dststep, const long dstcross,
+                          const int n, const int cols, const int k, const unsigned char flip,
+                          unsigned char* e, unsigned char* g, unsigned char* h)
+{
+    const int S = VC_MORPH_STRIP;
+    const int left = k / 2;
+    const int len = (n + k - 1 + k - 1) / k * k;
+
+    memset(e, 0, (size_t)len * S);
+    for (int i = 0; i < n; i++) {
+        for (int c = 0; c < cols; c++) e[(left + i) * S + c] = src[i * srcstep + c * srccross] ^ flip;
+    }
+
+    for (int b = 0; b < len; b += k) {
+        memcpy(g + b * S, e + b * S, S);
+        for (int i = b + 1; i < b + k; i++) {
+            for (int c = 0; c < S; c++) g[i * S + c] = MAX(g[(i - 1) * S + c], e[i * S + c]);
+        }
+
+        memcpy(h + (b + k - 1) * S, e + (b + k - 1) * S, S);
+        for (int i = b + k - 2; i >= b; i--) {
+            for (int c = 0; c < S; c++) h[i * S + c] = MAX(h[(i + 1) * S + c], e[i * S + c]);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int c = 0; c < cols; c++) {
+            dst[i * dststep + c * dstcross] = MAX(h[i * S + c], g[(i + k - 1) * S + c]) ^ flip;
+        }
+    }
+}
+
+
+/**
+ * @brief Maximo (ou minimo) num kernel retangular com custo O(1) por pixel
+ *
+ * Separavel: passagem horizontal de src para dst, seguida de passagem vertical
+ * sobre dst. Os pixeis fora da imagem sao ignorados. Pode operar no local.
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @param flip 0 para maximo (dilatacao), 255 para minimo (erosao)
+ * @return int
+ */
+static int vc_gray_rect_filter(const IVC* src, const IVC* dst, const int kwidth, const int kheight, const unsigned char flip)
+{
+    const int width = src->width;
+    const int height = src->height;
+    const int kmax = MAX(kwidth, kheight);
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+    if (src->channels != 1 || dst->channels != 1) return 0;
+    if (kwidth < 1 || kheight < 1) return 0;
+
+    // As faixas sao independentes: cada thread trata faixas inteiras com a sua memoria temporaria
+    const int nt = vc_kernel_threads(width, height);
+    const size_t line = (size_t)MAX(width, height) + 2 * kmax;
+    const size_t per = line * 3 * VC_MORPH_STRIP;
+    unsigned char* tmp = malloc(per * nt);
+    if (tmp == NULL) return 0;
+
+    // Passagem horizontal (src -> dst), em faixas de linhas
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y += VC_MORPH_STRIP) {
+        const int rows = MIN(VC_MORPH_STRIP, height - y);
+        const unsigned char* row_src = src->data + y * src->bytesperline;
+        unsigned char* row_dst = dst->data + y * dst->bytesperline;
+        unsigned char* e = tmp + per * vc_thread_index();
+
+        if (kwidth > 1) {
+            vc_vhgw_strip(row_src, 1, src->bytesperline, row_dst, 1, dst->bytesperline, width, rows, kwidth, flip,
+                          e, e + line * VC_MORPH_STRIP, e + 2 * line * VC_MORPH_STRIP);
+        } else if (row_dst != row_src) {
+            for (int r = 0; r < rows; r++) memcpy(row_dst + r * dst->bytesperline, row_src + r * src->bytesperline, width);
+        }
+    }
+
+    // Passagem vertical (dst -> dst), em faixas de colunas
+    if (kheight > 1) {
+        VC_OMP_PARALLEL_FOR(nt)
+        for (int x = 0; x < width; x += VC_MORPH_STRIP) {
+            unsigned char* e = tmp + per * vc_thread_index();
+
+            vc_vhgw_strip(dst->data + x, dst->bytesperline, 1, dst->data + x, dst->bytesperline, 1,
+                          height, MIN(VC_MORPH_STRIP, width - x), kheight, flip,
+                          e, e + line * VC_MORPH_STRIP, e + 2 * line * VC_MORPH_STRIP);
+        }
+    }
+
+    free(tmp);
+    return 1;
+}
+
+
+/**
+ * @brief Erosao em escala de cinza com kernel retangular (minimo)
+ *
+ * O custo por pixel e constante para qualquer tamanho de kernel. Uma erosao
+ * repetida n vezes com kernel 3x3 equivale a uma erosao com kernel (2n+1)x(2n+1).
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_gray_erode_rect(const IVC* src, const IVC* dst, const int kwidth, const int kheight)
+{
+    return vc_gray_rect_filter(src, dst, kwidth, kheight, 255);
+}
+
+
+/**
+ * @brief Dilatacao em escala de cinza com kernel retangular (maximo)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_gray_dilate_rect(const IVC* src, const IVC* dst, const int kwidth, const int kheight)
+{
+    return vc_gray_rect_filter(src, dst, kwidth, kheight, 0);
+}
+
+
+/**
+ * @brief Abertura com kernel retangular (erosao seguida de dilatacao)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_gray_open_rect(const IVC* src, const IVC* dst, const int kwidth, const int kheight)
+{
+    return vc_gray_erode_rect(src, dst, kwidth, kheight) && vc_gray_dilate_rect(dst, dst, kwidth, kheight);
+}
+
+
+/**
+ * @brief Fecho com kernel retangular (dilatacao seguida de erosao)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_gray_close_rect(const IVC* src, const IVC* dst, const int kwidth, const int kheight)
+{
+    return vc_gray_dilate_rect(src, dst, kwidth, kheight) && vc_gray_erode_rect(dst, dst, kwidth, kheight);
+}
+
+
+/**
+ * @brief Threshold local pelo ponto medio entre o minimo e o maximo da vizinhanca
+ *
+ * O minimo e o maximo da janela kernel x kernel (limitada a imagem) sao obtidos
+ * com vc_gray_erode_rect() e vc_gray_dilate_rect(), pelo que o custo por pixel
+ * nao depende do tamanho do kernel. Um pixel fica a 255 se for maior que
+ * (min + max) / 2 (arredondado por defeito).
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+static int vc_gray_to_binary_local_midrange(const IVC* src, const IVC* dst, const int kernel)
+{
+    const int k = 2 * ((kernel - 1) / 2) + 1;
+    int ret = 1;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels) return 0;
+    if (src->channels != 1) return 0;
+
+    IVC* min = vc_image_new(src->width, src->height, 1, src->levels);
+    IVC* max = vc_image_new(src->width, src->height, 1, src->levels);
+
+    if (min == NULL || max == NULL) ret = 0;
+    else ret = vc_gray_erode_rect(src, min, k, k) && vc_gray_dilate_rect(src, max, k, k);
+
+    for (int y = 0; ret && y < src->height; y++) {
+        const unsigned char* row = src->data + y * src->bytesperline;
+        const unsigned char* rmin = min->data + y * min->bytesperline;
+        const unsigned char* rmax = max->data + y * max->bytesperline;
+        unsigned char* out = dst->data + y * dst->bytesperline;
+
+        for (int x = 0; x < src->width; x++) {
+            const unsigned char threshold = (unsigned char)((rmin[x] + rmax[x]) >> 1);
+            out[x] = row[x] > threshold ? 255 : 0;
+        }
+    }
+
+    vc_image_free(min);
+    vc_image_free(max);
+    return ret;
+}
+
+
+/**
+ * @brief Conversao de escala de cinza para binario
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+int vc_gray_to_binary_midpoint(const IVC* src, const IVC* dst, const int kernel)
+{
+    return vc_gray_to_binary_local_midrange(src, dst, kernel);
+}
+
+
+/**
+ * @brief Converte imagem de grayscale para binario (threshold automatico Bernson)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+int vc_gray_to_binary_bernson(const IVC* src, const IVC* dst, const int kernel)
+{
+    return vc_gray_to_binary_local_midrange(src, dst, kernel);
+}
+
+
+/**
+ * @brief Dilatacao binaria
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+int vc_binary_dilate(const IVC* src, const IVC* dst, const int kernel)
+{
+    const int offset = kernel / 2;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels) return 0;
+    if (src->channels != 1) return 0;
+
+    // Um pixel fica a 255 se algum vizinho for 255, isto e, se o maximo da vizinhanca for 255
+    if (!vc_gray_dilate_rect(src, dst, 2 * offset + 1, 2 * offset + 1)) return 0;
+
+    for (int y = 0; y < dst->height; y++) {
+        unsigned char* row = dst->data + y * dst->bytesperline;
+        for (int x = 0; x < dst->width; x++) row[x] = row[x] == 255 ? 255 : 0;
+    }
+    return 1;
+}
+
+
+/**
+ * @brief Abertura binaria
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+int vc_binary_open(const IVC* src, const IVC* dst, const int kernel)
+{
+    int ret = 1;
+
+    IVC* aux = vc_image_new(src->width, src->height, src->channels, src->levels);
+    ret &= vc_binary_erode(src, aux, kernel);
+    ret &= vc_binary_dilate(aux, dst, kernel);
+    vc_image_free(aux);
+
+    return ret;
+}
+
+
+/**
+ * @brief Fechamento binario
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param kernel Tamanho do kernel
+ * @return int
+ */
+int vc_binary_close(const IVC* src, const IVC* dst, const int kernel)
+{
+    int ret = 1;
+
+    IVC* aux = vc_image_new(src->width, src->height, src->channels, src->levels);
+    ret &= vc_binary_dilate(src, aux, kernel);
+    ret &= vc_binary_erode(aux, dst, kernel);
+    vc_image_free(aux);
+
+    return ret;
 }
 
 
 /**
- * @brief Informacao de blobs
+ * @brief Numero de bits a 1 numa palavra de 64 bits
  *
- * @param src Imagem binaria de entrada
- * @param blobs Lista de blobs
- * @param nblobs Numero de blobs
+ * @param x Palavra
  * @return int
  */
-int vc_binary_blob_info(const IVC* src, OVC* blobs, int nblobs)
+static int vc_popcount64(uint64_t x)
 {
-    const unsigned char* data = src->data;
-    const int width = src->width;
-    const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
-
-    // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
-    if (channels != 1) return 0;
-
-    // Conta area de cada blob
-    for (int i = 0; i < nblobs; i++) {
-        int xmin = width - 1;
-        int ymin = height - 1;
-        int xmax = 0;
-        int ymax = 0;
-        long int sumx = 0;
-        long int sumy = 0;
-        blobs[i].area = 0;
-
-        for (int y = 1; y < height - 1; y++) {
-            for (int x = 1; x < width - 1; x++) {
-                const long int pos = y * bytesperline + x * channels;
-
-                if (data[pos] == blobs[i].label) {
-                    blobs[i].area++; // Area
-
-                    // Centro de Gravidade
-                    sumx += x;
-                    sumy += y;
-
-                    // Bounding Box
-                    if (xmin > x) xmin = x;
-                    if (ymin > y) ymin = y;
-                    if (xmax < x) xmax = x;
-                    if (ymax < y) ymax = y;
-
-                    // Perimetro
-                    // Se pelo menos um dos quatro vizinhos nao pertence ao mesmo label, entao e um pixel de contorno
-                    if (data[pos - 1] != blobs[i].label
-                        || data[pos + 1] != blobs[i].label
-                        || data[pos - bytesperline] != blobs[i].label
-                        || data[pos + bytesperline] != blobs[i].label
-                        ) {
-                        blobs[i].perimeter++;
-                    }
-                }
-            }
-        }
-
-        // Bounding Box
-        blobs[i].x = xmin;
-        blobs[i].y = ymin;
-        blobs[i].width = xmax - xmin + 1;
-        blobs[i].height = ymax - ymin + 1;
-
-        // Centro de Gravidade
-        blobs[i].xc = sumx / MAX(blobs[i].area, 1);
-        blobs[i].yc = sumy / MAX(blobs[i].area, 1);
-    }
-    return 1;
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
 }
 
 
 /**
- * @brief Calcula e identifica bounding box
+ * @brief Indice do bit a 1 menos significativo (x != 0)
  *
- * @param x Coordenada x
- * @param y Coordenada y
- * @param largura Largura
- * @param altura Altura
- * @param isaida Imagem de saida
+ * @param x Palavra
  * @return int
  */
-int vc_draw_bounding_box(const int x, const int y, int largura, int altura, const IVC* isaida)
+static int vc_ctz64(uint64_t x)
 {
-    unsigned char* datadst = isaida->data;
-    int bytesperline_dst = isaida->width * isaida->channels;
-    const int channels_dst = isaida->channels;
-    int width_dst = isaida->width;
-    int height_dst = isaida->height;
-    long int pos;
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) { x >>= 1; n++; }
+    return n;
+#endif
+}
 
-    for (int i = x; i < x + largura; i++) {
-        pos = y * bytesperline_dst + i * channels_dst;
-        datadst[pos] = 0;
-        datadst[pos + 1] = 0;
-        datadst[pos + 2] = 0;
 
-        pos = (y + altura) * bytesperline_dst + i * channels_dst;
-        datadst[pos] = 0;
-        datadst[pos + 1] = 0;
-        datadst[pos + 2] = 0;
-    }
+/**
+ * @brief Indice do bit a 1 mais significativo (x != 0)
+ *
+ * @param x Palavra
+ * @return int
+ */
+static int vc_msb64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(x);
+#else
+    int n = 0;
+    while (x >>= 1) n++;
+    return n;
+#endif
+}
 
-    for (int i = y; i < y + altura; i++) {
-        pos = i * bytesperline_dst + x * channels_dst;
-        datadst[pos] = 0;
-        datadst[pos + 1] = 0;
-        datadst[pos + 2] = 0;
 
-        pos = i * bytesperline_dst + (x + largura) * channels_dst;
-        datadst[pos] = 0;
-        datadst[pos + 1] = 0;
-        datadst[pos + 2] = 0;
-    }
-    return 1;
+/**
+ * @brief Mascara dos bits validos da ultima palavra de cada linha
+ *
+ * @param width Largura
+ * @return uint64_t
+ */
+static uint64_t vc_bit_tailmask(const int width)
+{
+    return width & 63 ? (1ULL << (width & 63)) - 1 : ~0ULL;
 }
 
 
 /**
- * @brief Calcula e identifica centro da imagem
+ * @brief Alocar memoria para uma imagem binaria compactada (inicializada a 0)
  *
- * @param x Coordenada x
- * @param y Coordenada y
- * @param xc Coordenada x do centro
- * @param yc Coordenada y do centro
- * @param largura Largura
- * @param altura Altura
- * @param isaida Imagem de saida
- * @return int
+ * @param width Largura
+ * @param height Altura
+ * @return BVC*
  */
-int vc_center_of_mass(const int x, const int y, const int xc, const int yc, int largura, int altura, const IVC* isaida)
+BVC* vc_bitimage_new(const int width, const int height)
 {
-    unsigned char* datadst = isaida->data;
-    int bytesperline_dst = isaida->width * isaida->channels;
-    const int channels_dst = isaida->channels;
-    const int width_dst = isaida->width;
-    const int height_dst = isaida->height;
+    if (width <= 0 || height <= 0) return NULL;
 
-    // Limites para evitar estouro de memoria
-    for (int i = x; i < x + largura; i++) {
-        for (int j = y; j < y + altura; j++) {
-            if (xc == i && yc == j) {
-                if (i >= 0 && i < width_dst && j >= 0 && j < height_dst) {
-                    long int pos = j * bytesperline_dst + i * channels_dst;
-                    datadst[pos] = 0;
-                    datadst[pos + 1] = 0;
-                    datadst[pos + 2] = 0;
+    BVC* image = malloc(sizeof(BVC));
+    if (image == NULL) return NULL;
 
-                    for (int k = 1; k < 6; k++) {
-                        // Verificacao para os limites superiores e inferiores ao centro de massa
-                        if (j - k >= 0 && j - k < height_dst) {
-                            pos = (j - k) * bytesperline_dst + i * channels_dst;
-                            datadst[pos] = 0;
-                            datadst[pos + 1] = 0;
-                            datadst[pos + 2] = 0;
-                        }
+    image->width = width;
+    image->height = height;
+    image->wordsperline = (width + 63) / 64;
+    image->data = calloc((size_t)image->wordsperline * height, sizeof(uint64_t));
 
-                        if (j + k >= 0 && j + k < height_dst) {
-                            pos = (j + k) * bytesperline_dst + i * channels_dst;
-                            datadst[pos] = 0;
-                            datadst[pos + 1] = 0;
-                            datadst[pos + 2] = 0;
-                        }
+    if (image->data == NULL) return vc_bitimage_free(image);
 
-                        // Verificacao para os limites a esquerda e a direita do centro de massa
-                        if (i + k >= 0 && i + k < width_dst) {
-                            pos = j * bytesperline_dst + (i + k) * channels_dst;
-                            datadst[pos] = 0;
-                            datadst[pos + 1] = 0;
-                            datadst[pos + 2] = 0;
-                        }
+    return image;
+}
 
-                        if (i - k >= 0 && i - k < width_dst) {
-                            pos = j * bytesperline_dst + (i - k) * channels_dst;
-                            datadst[pos] = 0;
-                            datadst[pos + 1] = 0;
-                            datadst[pos + 2] = 0;
-                        }
-                    }
-                }
-            }
-        }
+
+/**
+ * @brief Libertar memoria de uma imagem binaria compactada
+ *
+ * @param image Imagem
+ * @return BVC*
+ */
+BVC* vc_bitimage_free(BVC* image)
+{
+    if (image != NULL) {
+        free(image->data);
+        free(image);
     }
-    return 1;
+    return NULL;
 }
 
 
 /**
- * @brief Conta pixels brancos da imagem
+ * @brief Compacta uma mascara (1 byte por pixel) numa imagem binaria; pixel != 0 fica a 1
  *
- * @param image Imagem de entrada
+ * @param src Imagem de entrada (1 canal)
+ * @param dst Imagem binaria de saida
  * @return int
  */
-int countWhitePixels(const IVC* image) {
-    int count = 0;
-    const int bytesPerLine = image->channels * image->width;
+int vc_gray_to_bitimage(const IVC* src, const BVC* dst)
+{
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height || src->channels != 1) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        const unsigned char* row = src->data + y * src->bytesperline;
+        uint64_t* bits = dst->data + (size_t)y * dst->wordsperline;
+        int x = 0;
+
+#ifdef VC_SIMD_SSE2
+        // 64 pixels por palavra: a mascara de bytes nulos de cada bloco de 16 da 16 bits
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 64 <= src->width; x += 64) {
+            uint64_t w = 0;
+            for (int k = 0; k < 4; k++) {
+                const __m128i p = _mm_loadu_si128((const __m128i*)(row + x + 16 * k));
+                w |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(p, zero)) << (16 * k);
+            }
+            bits[x >> 6] = ~w;
+        }
+#endif
 
-    for (int y = 0; y < image->height; y++) {
-        for (int x = 0; x < image->width; x++) {
-            const long int pos = y * bytesPerLine + x * image->channels;
-            if (image->data[pos] == 255) count++;
+        for (; x < src->width; x += 64) {
+            const int n = MIN(64, src->width - x);
+            uint64_t w = 0;
+            for (int k = 0; k < n; k++) w |= (uint64_t)(row[x + k] != 0) << k;
+            bits[x >> 6] = w;
         }
     }
-    return count;
+    return 1;
 }
 
 
 /**
- * @brief Verifica a cor predominante da imagem
+ * @brief Expande uma imagem binaria para 1 byte por pixel (pixel a 1 fica com dst->levels)
  *
- * @param image Imagem de entrada
+ * @param src Imagem binaria de entrada
+ * @param dst Imagem de saida (1 canal)
  * @return int
  */
-int colors_check(const IVC* image)
+int vc_bitimage_to_gray(const BVC* src, const IVC* dst)
 {
-    const IVC* imageRED = vc_image_new(image->width, image->height, 3, image->levels);
-    const IVC* imageBLUE = vc_image_new(image->width, image->height, 3, image->levels);
-    int countRed = 0;
-    int countBlue = 0;
-    int aux = -1;
-
-    vc_hsv_segmentation(image, imageRED, 240, 255, 17, 100, 20, 100);
-
-    countRed = countWhitePixels(imageRED);
-
-    vc_hsv_segmentation(image, imageRED, 0, 15, 17, 100, 20, 100);
-    countRed += countWhitePixels(imageRED);
-    printf("Count Red: %d\n", countRed);
-
-    vc_hsv_segmentation(image, imageBLUE, 15, 60, 40, 100, 10, 100);
+    const unsigned char on = (unsigned char)dst->levels;
 
-    countBlue = countWhitePixels(imageBLUE);
-    printf("Count Blue: %d\n", countBlue);
+    // Verificacao de erros
+    if (dst->width <= 0 || dst->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height || dst->channels != 1) return 0;
+
+    for (int y = 0; y < src->height; y++) {
+        const uint64_t* bits = src->data + (size_t)y * src->wordsperline;
+        unsigned char* row = dst->data + y * dst->bytesperline;
+        int x = 0;
+
+#ifdef VC_SIMD_SSE2
+        // Cada byte da palavra e replicado 8 vezes e comparado com a mascara do seu bit
+        const __m128i sel = _mm_set_epi8((char)128, 64, 32, 16, 8, 4, 2, 1, (char)128, 64, 32, 16, 8, 4, 2, 1);
+        const __m128i val = _mm_set1_epi8((char)on);
+        for (; x + 16 <= src->width; x += 16) {
+            const unsigned int b = (unsigned int)(bits[x >> 6] >> (x & 63)) & 0xFFFF;
+            __m128i p = _mm_set_epi64x((long long)(0x0101010101010101ULL * (b >> 8)),
+                                       (long long)(0x0101010101010101ULL * (b & 0xFF)));
+            p = _mm_cmpeq_epi8(_mm_and_si128(p, sel), sel);
+            _mm_storeu_si128((__m128i*)(row + x), _mm_and_si128(p, val));
+        }
+#endif
 
-    if (countRed > countBlue && countRed > 1000) {
-        aux = 0;  // Vermelho
-    } else if (countBlue > countRed && countBlue > 500) {
-        aux = 1;  // Azul
+        for (; x < src->width; x++) row[x] = (bits[x >> 6] >> (x & 63)) & 1 ? on : 0;
     }
+    return 1;
+}
 
-    return aux;
+
+/**
+ * @brief Converte 8 bytes de uma palavra entre a ordem da imagem binaria e a do PBM
+ *
+ * No PBM o primeiro pixel e o bit mais significativo de cada byte e 1 = preto; na
+ * imagem binaria o primeiro pixel e o bit menos significativo e 1 = branco. A
+ * conversao (inverter os bits de cada byte e negar) e a sua propria inversa.
+ *
+ * @param w Palavra
+ * @return uint64_t
+ */
+static uint64_t vc_bit_pbm_swap(uint64_t w)
+{
+    w = (w & 0xF0F0F0F0F0F0F0F0ULL) >> 4 | (w & 0x0F0F0F0F0F0F0F0FULL) << 4;
+    w = (w & 0xCCCCCCCCCCCCCCCCULL) >> 2 | (w & 0x3333333333333333ULL) << 2;
+    w = (w & 0xAAAAAAAAAAAAAAAAULL) >> 1 | (w & 0x5555555555555555ULL) << 1;
+    return ~w;
 }
 
 
 /**
- * @brief Calcula a redondeza da imagem
+ * @brief Le uma imagem PBM (P4) diretamente para uma imagem binaria compactada
  *
- * @param binaryImage Imagem binaria de entrada
- * @return float
+ * @param filename Nome do ficheiro
+ * @return BVC*
  */
-float vc_calculate_roundness(const IVC* binaryImage)
+BVC* vc_bitimage_read_pbm(const char* filename)
 {
-    const unsigned char* data = (unsigned char*)binaryImage->data;
-    int bytesperline = binaryImage->width * binaryImage->channels;
-    const int channels = binaryImage->channels;
-    const int width = binaryImage->width;
-    const int height = binaryImage->height;
-    int area = 0;
-    int perimeter = 0;
+    FILE* file = fopen(filename, "rb");
+    BVC* image = NULL;
+    char tok[20];
+    int width, height;
 
-    // Itera sobre todos os pixeis da imagem
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = y * bytesperline + x * channels;
+    if (file == NULL) {
+#ifdef VC_DEBUG
+        printf("ERROR -> vc_bitimage_read_pbm():\n\tFile not found.\n");
+#endif
+        return NULL;
+    }
 
-            // Se o pixel faz parte do objeto (diferente de zero), incrementa a area
-            if (data[pos] != 0) {
-                area++;
+    if (strcmp(netpbm_get_token(file, tok, sizeof(tok)), "P4") != 0 ||
+        sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1 ||
+        sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1 ||
+        (image = vc_bitimage_new(width, height)) == NULL)
+    {
+#ifdef VC_DEBUG
+        printf("ERROR -> vc_bitimage_read_pbm():\n\tFile is not a valid PBM file.\n");
+#endif
+        fclose(file);
+        return NULL;
+    }
 
-                // Verifica se o pixel faz parte do contorno do objeto
-                if (x > 0 && data[pos - channels] == 0
-                    || x < width - 1 && data[pos + channels] == 0
-                    || y > 0 && data[pos - bytesperline] == 0
-                    || y < height - 1 && data[pos + bytesperline] == 0
-                    ) {
-                    perimeter++;
-                }
-            }
+    // Cada linha PBM ocupa os primeiros bytes da linha de palavras correspondente
+    const size_t rowbytes = (size_t)(width + 7) / 8;
+    unsigned char* tmp = malloc(rowbytes);
+    if (tmp == NULL) {
+        fclose(file);
+        return vc_bitimage_free(image);
+    }
+
+    for (int y = 0; y < height; y++) {
+        uint64_t* bits = image->data + (size_t)y * image->wordsperline;
+
+        if (fread(tmp, 1, rowbytes, file) != rowbytes) {
+#ifdef VC_DEBUG
+            printf("ERROR -> vc_bitimage_read_pbm():\n\tPremature EOF on file.\n");
+#endif
+            free(tmp);
+            fclose(file);
+            return vc_bitimage_free(image);
+        }
+
+        for (int i = 0; i < image->wordsperline; i++) {
+            uint64_t w = 0;
+            for (size_t k = 0; k < 8 && i * 8 + k < rowbytes; k++) w |= (uint64_t)tmp[i * 8 + k] << (8 * k);
+            bits[i] = vc_bit_pbm_swap(w);
         }
+        bits[image->wordsperline - 1] &= vc_bit_tailmask(width);
     }
-    if (perimeter == 0) return 0;  // Evita divisao por zero
-    const float roundness = 4 * M_PI * area / (float)(perimeter * perimeter);
 
-    return roundness;
+    free(tmp);
+    fclose(file);
+    return image;
 }
 
 
 /**
- * @brief Verifica se a imagem e um circulo
+ * @brief Escreve uma imagem binaria compactada num ficheiro PBM (P4)
  *
- * @param image Imagem de entrada
+ * @param filename Nome do ficheiro
+ * @param image Imagem
  * @return int
  */
-int vc_stop_forbiden_distinction(const IVC* image)
+int vc_bitimage_write_pbm(const char* filename, const BVC* image)
 {
-    const float roundness = vc_calculate_roundness(image);
-    int aux = -1;
+    if (image == NULL || image->data == NULL) return 0;
 
-    printf("Roundness: %f\n", roundness);
+    const size_t rowbytes = (size_t)(image->width + 7) / 8;
+    unsigned char* tmp = malloc((size_t)image->wordsperline * 8);
+    if (tmp == NULL) return 0;
 
-    // caso se verifique que a roundness o maior que 0.15 o Sentido Proibido
-    if (roundness >= 0.15) {
-        aux = 1;
-    } else if (roundness < 0.15) { // Se for menor que 0.15, o STOP
-        aux = 0;
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        free(tmp);
+        return 0;
     }
 
-    return aux;
+    fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
+
+    // Os bits de enchimento do ultimo byte de cada linha ficam a 0
+    const uint64_t tail = ~vc_bit_pbm_swap(vc_bit_tailmask(image->width));
+
+    for (int y = 0; y < image->height; y++) {
+        const uint64_t* bits = image->data + (size_t)y * image->wordsperline;
+
+        for (int i = 0; i < image->wordsperline; i++) {
+            const uint64_t w = vc_bit_pbm_swap(bits[i]) & (i == image->wordsperline - 1 ? tail : ~0ULL);
+            for (int k = 0; k < 8; k++) tmp[i * 8 + k] = (unsigned char)(w >> (8 * k));
+        }
+
+        if (fwrite(tmp, 1, rowbytes, file) != rowbytes) {
+#ifdef VC_DEBUG
+            fprintf(stderr, "ERROR -> vc_bitimage_write_pbm():\n\tError writing PBM file.\n");
+#endif
+            free(tmp);
+            fclose(file);
+            return 0;
+        }
+    }
+
+    free(tmp);
+    fclose(file);
+    return 1;
 }
 
 
 /**
- * @brief Verifica a cor predominante da imagem
+ * @brief row[x] |= row[x + s] (fora da linha conta como 0)
  *
- * @param image Imagem de entrada
- * @param xbb Coordenada x da bounding box
- * @param ybb Coordenada y da bounding box
- * @param widthbb Largura da bounding box
- * @param heightbb Altura da bounding box
- * @return int
+ * @param row Linha
+ * @param words Numero de palavras
+ * @param s Deslocamento (> 0)
  */
-int vc_arrows_distinction(const IVC* image, const int xbb, const int ybb, int widthbb, int heightbb)
+static void vc_bit_or_next(uint64_t* row, const int words, const int s)
 {
-    const unsigned char* data = (unsigned char*)image->data;
-    int bytesperline = image->width * image->channels;
-    const int height = image->height;
-    const int width = image->width;
-    int countLeft = 0;
-    int countRight = 0;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = y * bytesperline + x * image->channels;
+    const int q = s >> 6, r = s & 63;
 
-            if (x >= xbb && x <= xbb + widthbb && (y >= ybb && y <= ybb + heightbb)) { // Dentro da bounding box
-                if (x < xbb + widthbb / 2) {
-                    if (data[pos] == 0) countLeft++;
-                } else {
-                    if (data[pos] == 0) countRight++;
-                }
-            }
-        }
+    for (int i = 0; i + q < words; i++) {
+        const uint64_t lo = row[i + q];
+        const uint64_t hi = i + q + 1 < words ? row[i + q + 1] : 0;
+        row[i] |= r ? lo >> r | hi << (64 - r) : lo;
     }
+}
 
-    printf("Count Left: %d\n", countLeft);
-    printf("Count Right: %d\n", countRight);
 
-    if (countLeft > countRight) return 1;
-    return 2;
+/**
+ * @brief row[x] |= row[x - s] (fora da linha conta como 0)
+ *
+ * @param row Linha
+ * @param words Numero de palavras
+ * @param s Deslocamento (> 0)
+ */
+static void vc_bit_or_prev(uint64_t* row, const int words, const int s)
+{
+    const int q = s >> 6, r = s & 63;
+
+    for (int i = words - 1; i - q >= 0; i--) {
+        const uint64_t hi = row[i - q];
+        const uint64_t lo = i - q - 1 >= 0 ? row[i - q - 1] : 0;
+        row[i] |= r ? hi << r | lo >> (64 - r) : hi;
+    }
 }
 
 
 /**
- * @brief Get token
+ * @brief Dilatacao (ou erosao) binaria compactada com kernel retangular
  *
- * @param file Ficheiro
- * @param tok
- * @param len
- * @return char*
+ * O OU de uma janela de n pixels obtem-se em log2(n) passos, duplicando a cada passo
+ * o alcance ja acumulado. A janela [x - k/2, x + (k-1)/2] e a uniao da metade para a
+ * frente e da metade para tras, ambas com o exterior a 0, e cada operacao trata 64
+ * pixels de uma vez. A erosao e a dilatacao do complemento (o exterior e ignorado).
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @param erode 1 para erosao, 0 para dilatacao
+ * @return int
  */
-char* netpbm_get_token(FILE* file, char* tok, const int len)
+static int vc_bitimage_rect_filter(const BVC* src, const BVC* dst, const int kwidth, const int kheight, const int erode)
 {
-    int c;
+    const int words = src->wordsperline;
+    const int height = src->height;
+    const uint64_t tail = vc_bit_tailmask(src->width);
+    const uint64_t flip = erode ? ~0ULL : 0;
 
-    for (;;) {
-        while (isspace(c = getc(file)))
-            ;
-        if (c != '#') break;
-        do c = getc(file);
-        while (c != '\n' && c != EOF);
-        if (c == EOF) break;
+    // Verificacao de erros
+    if (src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+    if (kwidth < 1 || kheight < 1) return 0;
+
+    uint64_t* tmp = malloc((size_t)words * height * sizeof(uint64_t));
+    if (tmp == NULL) return 0;
+
+    for (size_t i = 0; i < (size_t)words * height; i++) dst->data[i] = src->data[i] ^ flip;
+    for (int y = 0; y < height; y++) dst->data[(size_t)y * words + words - 1] &= tail;
+
+    // Passagem horizontal, linha a linha
+    if (kwidth > 1) {
+        const int left = kwidth / 2 + 1, right = (kwidth - 1) / 2 + 1;
+
+        for (int y = 0; y < height; y++) {
+            uint64_t* row = dst->data + (size_t)y * words;
+
+            memcpy(tmp, row, words * sizeof(uint64_t));
+            for (int n = 1; n < right; n += MIN(n, right - n)) vc_bit_or_next(row, words, MIN(n, right - n));
+            for (int n = 1; n < left; n += MIN(n, left - n)) vc_bit_or_prev(tmp, words, MIN(n, left - n));
+            for (int i = 0; i < words; i++) row[i] |= tmp[i];
+            row[words - 1] &= tail;
+        }
     }
 
-    char* t = tok;
+    // Passagem vertical, com linhas inteiras como unidade
+    if (kheight > 1) {
+        const int top = kheight / 2 + 1, bottom = (kheight - 1) / 2 + 1;
+        uint64_t* data = dst->data;
 
-    if (c != EOF) {
-        do {
-            *t++ = c;
-            c = getc(file);
-        } while (!isspace(c) && c != '#' && c != EOF && t - tok < len - 1);
+        memcpy(tmp, data, (size_t)words * height * sizeof(uint64_t));
+        for (int n = 1; n < bottom; n += MIN(n, bottom - n)) {
+            const size_t s = (size_t)MIN(n, bottom - n) * words;
+            for (size_t i = 0; i + s < (size_t)words * height; i++) data[i] |= data[i + s];
+        }
+        for (int n = 1; n < top; n += MIN(n, top - n)) {
+            const size_t s = (size_t)MIN(n, top - n) * words;
+            for (size_t i = (size_t)words * height; i-- > s;) tmp[i] |= tmp[i - s];
+        }
+        for (size_t i = 0; i < (size_t)words * height; i++) data[i] |= tmp[i];
+    }
 
-        if (c == '#') ungetc(c, file);
+    if (erode) {
+        for (size_t i = 0; i < (size_t)words * height; i++) dst->data[i] = ~dst->data[i];
+        for (int y = 0; y < height; y++) dst->data[(size_t)y * words + words - 1] &= tail;
     }
-    *t = 0;
 
-    return tok;
+    free(tmp);
+    return 1;
 }
 
 
 /**
- * @brief Converte unsigned char para bit
+ * @brief Erosao binaria compactada com kernel retangular
  *
- * @param datauchar
- * @param databit
- * @param width Largura
- * @param height Altura
- * @return long int
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
  */
-long int unsigned_char_to_bit(const unsigned char* datauchar, unsigned char* databit, const int width, const int height)
+int vc_bitimage_erode(const BVC* src, const BVC* dst, const int kwidth, const int kheight)
 {
-    unsigned char* p = databit;
+    return vc_bitimage_rect_filter(src, dst, kwidth, kheight, 1);
+}
 
-    *p = 0;
-    int countbits = 1;
-    long int counttotalbytes = 0;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = width * y + x;
+/**
+ * @brief Dilatacao binaria compactada com kernel retangular
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_bitimage_dilate(const BVC* src, const BVC* dst, const int kwidth, const int kheight)
+{
+    return vc_bitimage_rect_filter(src, dst, kwidth, kheight, 0);
+}
 
-            if (countbits <= 8) {
-                // Numa imagem PBM:
-                // 1 = Preto
-                // 0 = Branco
-                //*p |= (datauchar[pos] != 0) << (8 - countbits);
 
-                // Na nossa imagem:
-                // 1 = Branco
-                // 0 = Preto
-                *p |= (datauchar[pos] == 0) << 8 - countbits;
+/**
+ * @brief Abertura binaria compactada (erosao seguida de dilatacao)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_bitimage_open(const BVC* src, const BVC* dst, const int kwidth, const int kheight)
+{
+    return vc_bitimage_erode(src, dst, kwidth, kheight) && vc_bitimage_dilate(dst, dst, kwidth, kheight);
+}
 
-                countbits++;
-            }
 
-            if (countbits > 8 || x == width - 1) {
-                p++;
-                *p = 0;
-                countbits = 1;
-                counttotalbytes++;
-            }
-        }
-    }
-    return counttotalbytes;
+/**
+ * @brief Fecho binario compactado (dilatacao seguida de erosao)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kwidth Largura do kernel
+ * @param kheight Altura do kernel
+ * @return int
+ */
+int vc_bitimage_close(const BVC* src, const BVC* dst, const int kwidth, const int kheight)
+{
+    return vc_bitimage_dilate(src, dst, kwidth, kheight) && vc_bitimage_erode(dst, dst, kwidth, kheight);
 }
 
 
 /**
- * @brief Converte bit para unsigned char
+ * @brief Copiar uma imagem binaria compactada para outra com as mesmas dimensoes
  *
- * @param databit
- * @param datauchar
- * @param width Largura
- * @param height Altura
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
  */
-void bit_to_unsigned_char(const unsigned char* databit, unsigned char* datauchar, const int width, const int height)
+int vc_bitimage_copy(const BVC* src, const BVC* dst)
 {
-    const unsigned char* p = databit;
-    int countbits = 1;
+    if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = width * y + x;
+    if (src != dst) memcpy(dst->data, src->data, (size_t)src->wordsperline * src->height * sizeof(uint64_t));
 
-            if (countbits <= 8) {
-                // Numa imagem PBM:
-                // 1 = Preto
-                // 0 = Branco
-                //datauchar[pos] = (*p & (1 << (8 - countbits))) ? 1 : 0;
+    return 1;
+}
 
-                // Na nossa imagem:
-                // 1 = Branco
-                // 0 = Preto
-                datauchar[pos] = *p & 1 << 8 - countbits ? 0 : 1;
 
-                countbits++;
-            }
+/**
+ * @brief Numero de pixels a 1 de uma imagem binaria compactada
+ *
+ * @param src Imagem
+ * @return long
+ */
+long vc_bitimage_count(const BVC* src)
+{
+    long count = 0;
 
-            if (countbits > 8 || x == width - 1) {
-                p++;
-                countbits = 1;
-            }
-        }
-    }
+    if (src == NULL || src->data == NULL) return 0;
+
+    for (size_t i = 0; i < (size_t)src->wordsperline * src->height; i++) count += vc_popcount64(src->data[i]);
+
+    return count;
 }
 
 
 /**
- * @brief Le imagem
+ * @brief Caixa delimitadora e area dos pixels a 1 (caixa vazia se nao houver nenhum)
  *
- * @param filename Nome do ficheiro
- * @return IVC*
+ * @param src Imagem
+ * @param box Resultado (x, y, width, height e area)
+ * @return int
  */
-IVC* vc_read_image(const char* filename)
+int vc_bitimage_bbox(const BVC* src, OVC* box)
 {
-    FILE* file = NULL;
-    IVC* image = NULL;
-    int width, height;
-    int levels = 255;
-    int v;
-
-    // Abre o ficheiro
-    if ((file = fopen(filename, "rb")) != NULL) {
-        int channels;
-        char tok[20];
-
-        // Efetua a leitura do header
-        netpbm_get_token(file, tok, sizeof(tok));
-
-        if (strcmp(tok, "P4") == 0) { // Se PBM (Binary [0,1])
-            channels = 1;
-            levels = 1;
-        } else if (strcmp(tok, "P5") == 0)
-            channels = 1; // Se PGM (Gray [0,MAX(level,255)])
-        else if (strcmp(tok, "P6") == 0)
-            channels = 3; // Se PPM (RGB [0,MAX(level,255)])
-        else {
-#ifdef VC_DEBUG
-            printf("ERROR -> vc_read_image():\n\tFile is not a valid PBM, PGM or PPM file.\n\tBad magic number!\n");
-#endif
+    const int words = src->wordsperline;
+    int ymin = -1, ymax = -1;
+    long area = 0;
 
-            fclose(file);
-            return NULL;
-        }
+    // Verificacao de erros
+    if (src->data == NULL || box == NULL) return 0;
 
-        if (levels == 1) { // PBM
-            if (sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1
-                ||
-                sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1)
-            {
-#ifdef VC_DEBUG
-                printf("ERROR -> vc_read_image():\n\tFile is not a valid PBM file.\n\tBad size!\n");
-#endif
+    memset(box, 0, sizeof(OVC));
 
-                fclose(file);
-                return NULL;
-            }
+    // OU de todas as linhas nao vazias: as colunas extremas sao o primeiro e o ultimo bit
+    uint64_t* cols = calloc(words, sizeof(uint64_t));
+    if (cols == NULL) return 0;
 
-            // Aloca memoria para imagem
-            image = vc_image_new(width, height, channels, levels);
-            if (image == NULL) return NULL;
+    for (int y = 0; y < src->height; y++) {
+        const uint64_t* row = src->data + (size_t)y * words;
+        uint64_t any = 0;
 
-            long int sizeofbinarydata = (image->width / 8 + (image->width % 8 ? 1 : 0)) * image->height;
-            unsigned char* tmp = malloc(sizeofbinarydata);
-            if (tmp == NULL) return 0;
+        for (int i = 0; i < words; i++) {
+            any |= row[i];
+            cols[i] |= row[i];
+            area += vc_popcount64(row[i]);
+        }
 
-#ifdef VC_DEBUG
-            printf("\nchannels=%d w=%d h=%d levels=%d\n", image->channels, image->width, image->height, levels);
-#endif
+        if (any) {
+            if (ymin < 0) ymin = y;
+            ymax = y;
+        }
+    }
 
-            if ((v = fread(tmp, sizeof(unsigned char), sizeofbinarydata, file)) != sizeofbinarydata){
-#ifdef VC_DEBUG
-                printf("ERROR -> vc_read_image():\n\tPremature EOF on file.\n");
-#endif
+    if (ymin >= 0) {
+        int first = 0, last = words - 1;
+        while (cols[first] == 0) first++;
+        while (cols[last] == 0) last--;
 
-                vc_image_free(image);
-                fclose(file);
-                free(tmp);
-                return NULL;
-            }
+        box->x = first * 64 + vc_ctz64(cols[first]);
+        box->y = ymin;
+        box->width = last * 64 + vc_msb64(cols[last]) - box->x + 1;
+        box->height = ymax - ymin + 1;
+        box->area = (int)area;
+    }
 
-            bit_to_unsigned_char(tmp, image->data, image->width, image->height);
-            free(tmp);
-        } else { // PGM ou PPM
-            long int size;
-            if (sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &width) != 1 ||
-                sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &height) != 1 ||
-                sscanf(netpbm_get_token(file, tok, sizeof(tok)), "%d", &levels) != 1 || levels <= 0 || levels > 255)
-            {
-#ifdef VC_DEBUG
-                printf("ERROR -> vc_read_image():\n\tFile is not a valid PGM or PPM file.\n\tBad size!\n");
-#endif
+    free(cols);
+    return 1;
+}
 
-                fclose(file);
-                return NULL;
-            }
 
-            // Aloca memoria para imagem
-            image = vc_image_new(width, height, channels, levels);
-            if (image == NULL) return NULL;
+/**
+ * @brief Alocar uma mascara RLE vazia
+ *
+ * @param width Largura
+ * @param height Altura
+ * @return RVC*
+ */
+RVC* vc_rle_new(const int width, const int height)
+{
+    if (width <= 0 || height <= 0) return NULL;
 
-#ifdef VC_DEBUG
-            printf("\nchannels=%d w=%d h=%d levels=%d\n", image->channels, image->width, image->height, levels);
-#endif
+    RVC* rle = malloc(sizeof(RVC));
+    if (rle == NULL) return NULL;
 
-            size = image->width * image->height * image->channels;
+    rle->width = width;
+    rle->height = height;
+    rle->nruns = 0;
+    rle->capacity = 2 * height;
+    rle->runs = malloc(rle->capacity * sizeof(RUN));
+    rle->rowstart = calloc(height + 1, sizeof(int));
 
-            if ((v = fread(image->data, sizeof(unsigned char), size, file)) != size) {
-#ifdef VC_DEBUG
-                printf("ERROR -> vc_read_image():\n\tPremature EOF on file.\n");
-#endif
+    if (rle->runs == NULL || rle->rowstart == NULL) return vc_rle_free(rle);
 
-                vc_image_free(image);
-                fclose(file);
-                return NULL;
-            }
-        }
-        fclose(file);
-    } else {
-#ifdef VC_DEBUG
-        printf("ERROR -> vc_read_image():\n\tFile not found.\n");
-#endif
+    return rle;
+}
+
+
+/**
+ * @brief Libertar memoria de uma mascara RLE
+ *
+ * @param rle Mascara RLE
+ * @return RVC*
+ */
+RVC* vc_rle_free(RVC* rle)
+{
+    if (rle != NULL) {
+        free(rle->runs);
+        free(rle->rowstart);
+        free(rle);
     }
-    return image;
+    return NULL;
 }
 
 
 /**
- * @brief Escreve imagem
+ * @brief Acrescenta um run no fim da mascara (aumentando a capacidade se necessario)
  *
- * @param filename Nome do ficheiro
- * @param image Imagem
+ * @param rle Mascara RLE
+ * @param y Linha
+ * @param x0 Primeira coluna
+ * @param x1 Ultima coluna
  * @return int
  */
-int vc_write_image(const char* filename, const IVC* image)
+static int vc_rle_push(RVC* rle, const int y, const int x0, const int x1)
 {
-    FILE* file = NULL;
+    if (rle->nruns == rle->capacity) {
+        RUN* runs = realloc(rle->runs, 2 * (size_t)rle->capacity * sizeof(RUN));
+        if (runs == NULL) return 0;
+        rle->runs = runs;
+        rle->capacity *= 2;
+    }
 
-    if (image == NULL) return 0;
+    RUN* run = &rle->runs[rle->nruns++];
+    run->y = y;
+    run->x0 = x0;
+    run->x1 = x1;
+    run->label = 0;
+    return 1;
+}
 
-    if ((file = fopen(filename, "wb")) != NULL) {
-        if (image->levels == 1) {
-            long int sizeofbinarydata = (image->width / 8 + (image->width % 8 ? 1 : 0)) * image->height + 1;
-            unsigned char* tmp = malloc(sizeofbinarydata);
 
-            if (tmp == NULL) return 0;
-            fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
+/**
+ * @brief Codifica uma mascara (1 byte por pixel, != 0 = objeto) em runs
+ *
+ * @param src Imagem de entrada (1 canal)
+ * @param dst Mascara RLE de saida (mesmas dimensoes)
+ * @return int
+ */
+int vc_gray_to_rle(const IVC* src, RVC* dst)
+{
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height || src->channels != 1) return 0;
 
-            long int totalbytes = unsigned_char_to_bit(image->data, tmp, image->width, image->height);
-            printf("Total = %ld\n", totalbytes);
-            if (fwrite(tmp, sizeof(unsigned char), totalbytes, file) != totalbytes) {
-#ifdef VC_DEBUG
-                fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
-#endif
+    dst->nruns = 0;
 
-                fclose(file);
-                free(tmp);
-                return 0;
-            }
-            free(tmp);
-        } else {
-            fprintf(file, "%s %d %d 255\n", (image->channels == 1) ? "P5" : "P6", image->width, image->height);
+    for (int y = 0; y < src->height; y++) {
+        const unsigned char* row = src->data + y * src->bytesperline;
 
-            if (fwrite(image->data, image->bytesperline, image->height, file) != image->height) {
-#ifdef VC_DEBUG
-                fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
-#endif
+        dst->rowstart[y] = dst->nruns;
+        for (int x = 0; x < src->width; x++) {
+            if (row[x] == 0) continue;
 
-                fclose(file);
-                return 0;
-            }
+            const int x0 = x;
+            while (x + 1 < src->width && row[x + 1] != 0) x++;
+            if (!vc_rle_push(dst, y, x0, x)) return 0;
         }
-        fclose(file);
-        return 1;
     }
-    return 0;
+    dst->rowstart[src->height] = dst->nruns;
+
+    return 1;
 }
 
 
 /**
- * @brief Converte imagem para grayscale
+ * @brief Posicao do proximo bit igual a bit a partir de x (ou words * 64 se nao houver)
  *
- * @param srcdst
+ * @param row Linha da imagem binaria
+ * @param words Numero de palavras da linha
+ * @param x Posicao inicial
+ * @param bit Valor procurado (0 ou 1)
  * @return int
  */
-int vc_gray_negative(const IVC* srcdst)
+static int vc_bit_next(const uint64_t* row, const int words, const int x, const int bit)
 {
-    if (srcdst != NULL) {
-        // Validacao de erros
-        if (srcdst->channels != 1 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+    const uint64_t flip = bit ? 0 : ~0ULL;
+    int i = x >> 6;
 
-        for (int x = 0; x < srcdst->width; x++) {
-            for (int y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                //calcular a posicao do byte na posicao do pixel
-                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
-                srcdst->data[pos] = 255 - srcdst->data[pos];
-            }
-        }
+    if (i >= words) return words * 64;
+
+    uint64_t w = (row[i] ^ flip) & ~0ULL << (x & 63);
+    while (w == 0) {
+        if (++i == words) return words * 64;
+        w = row[i] ^ flip;
     }
-    return 1;
+    return i * 64 + vc_ctz64(w);
 }
 
 
 /**
- * @brief Converte imagem para grayscale
+ * @brief Codifica uma imagem binaria compactada em runs
  *
- * @param srcdst
+ * Os extremos de cada run sao encontrados palavra a palavra (64 pixels de cada vez).
+ *
+ * @param src Imagem binaria de entrada
+ * @param dst Mascara RLE de saida (mesmas dimensoes)
  * @return int
  */
-int vc_rgb_negative(const IVC* srcdst)
+int vc_bitimage_to_rle(const BVC* src, RVC* dst)
 {
-    if (srcdst != NULL) {
-        // Validacao de erros
-        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+    // Verificacao de erros
+    if (src->data == NULL || dst == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
 
-        for (int x = 0; x < srcdst->width; x++) {
-            for (int y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+    dst->nruns = 0;
 
-                srcdst->data[pos] = 255 - srcdst->data[pos];
-                srcdst->data[pos + 1] = 255 - srcdst->data[pos + 1];
-                srcdst->data[pos + 2] = 255 - srcdst->data[pos + 2];
-            }
+    for (int y = 0; y < src->height; y++) {
+        const uint64_t* row = src->data + (size_t)y * src->wordsperline;
+
+        dst->rowstart[y] = dst->nruns;
+        for (int x = vc_bit_next(row, src->wordsperline, 0, 1); x < src->width;
+             x = vc_bit_next(row, src->wordsperline, x, 1))
+        {
+            const int x0 = x;
+            x = MIN(vc_bit_next(row, src->wordsperline, x, 0), src->width);
+            if (!vc_rle_push(dst, y, x0, x - 1)) return 0;
         }
     }
+    dst->rowstart[src->height] = dst->nruns;
+
     return 1;
 }
 
 
 /**
- * @brief Converte imagem para grayscale
+ * @brief Descodifica uma mascara RLE (pixel de um run = dst->levels, restantes = 0)
  *
- * @param srcdst
+ * @param src Mascara RLE
+ * @param dst Imagem de saida (1 canal)
  * @return int
  */
-int vc_rgb_get_red_gray(const IVC* srcdst)
+int vc_rle_to_gray(const RVC* src, const IVC* dst)
 {
-    if (srcdst != NULL) {
-        // Validacao de erros
-        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+    // Verificacao de erros
+    if (src == NULL || dst->data == NULL || dst->channels != 1) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
 
-        for (int x = 0; x < srcdst->width; x++) {
-            for (int y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+    for (int y = 0; y < dst->height; y++) memset(dst->data + y * dst->bytesperline, 0, dst->width);
 
-                //se fosse obter apenas o vermelho basta apenas colocar a 0 o valor do verde e azul
-                srcdst->data[pos + 1] = srcdst->data[pos]; //verde
-                srcdst->data[pos + 2] = srcdst->data[pos]; //azul
-            }
-        }
+    for (int i = 0; i < src->nruns; i++) {
+        const RUN* run = &src->runs[i];
+        memset(dst->data + run->y * dst->bytesperline + run->x0, dst->levels, run->x1 - run->x0 + 1);
     }
     return 1;
 }
 
 
 /**
- * @brief Converte imagem para grayscale
+ * @brief Numero de pixeis de [a, b] cobertos por runs da linha de cima e da de baixo
  *
- * @param srcdst
+ * @param up Runs da linha de cima
+ * @param nup Numero de runs da linha de cima
+ * @param iu Primeiro run de cima ainda relevante (avanca com a)
+ * @param down Runs da linha de baixo
+ * @param ndown Numero de runs da linha de baixo
+ * @param id Primeiro run de baixo ainda relevante (avanca com a)
+ * @param a Primeira coluna
+ * @param b Ultima coluna
  * @return int
  */
-int vc_rgb_get_green_gray(const IVC* srcdst)
+static int vc_rle_covered(const RUN* up, const int nup, int* iu, const RUN* down, const int ndown, int* id, const int a, const int b)
 {
-    if (srcdst != NULL) {
-        // Validacao de erros
-        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+    int count = 0;
 
-        for (int x = 0; x < srcdst->width; x++) {
-            for (int y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+    while (*iu < nup && up[*iu].x1 < a) (*iu)++;
+    while (*id < ndown && down[*id].x1 < a) (*id)++;
 
-                //se fosse obter apenas o verde basta apenas colocar a 0 o valor do vermelho e azul
-                srcdst->data[pos] = srcdst->data[pos + 1];	   //vermelho
-                srcdst->data[pos + 2] = srcdst->data[pos + 1]; //azul
-            }
-        }
+    int k = *id;
+    for (int j = *iu; j < nup && up[j].x0 <= b; j++) {
+        const int c = MAX(a, up[j].x0), d = MIN(b, up[j].x1);
+
+        while (k < ndown && down[k].x1 < c) k++;
+        for (int m = k; m < ndown && down[m].x0 <= d; m++) count += MIN(d, down[m].x1) - MAX(c, down[m].x0) + 1;
     }
-    return 1;
+    return count;
 }
 
 
 /**
- * @brief Converte imagem para grayscale
+ * @brief Informacao de blobs a partir de uma mascara RLE etiquetada
  *
- * @param srcdst
+ * Area, bounding box e centro de massa sao acumulados run a run. Um pixel e de
+ * contorno se algum vizinho-4 for fundo ou estiver fora da imagem; os pixeis
+ * interiores de um run sao os que nao estao nos seus extremos e estao cobertos
+ * pelas linhas de cima e de baixo, o que tambem se conta sobre runs.
+ *
+ * @param rle Mascara RLE (etiquetas compactas 1..nblobs em cada run)
+ * @param blobs Lista de blobs (blobs[i] corresponde a etiqueta i + 1)
+ * @param nblobs Numero de blobs
+ * @param arena Memoria temporaria (NULL = heap)
  * @return int
  */
-int vc_rgb_get_blue_gray(const IVC* srcdst)
+static int vc_rle_blob_info_scratch(const RVC* rle, OVC* blobs, const int nblobs, AVC* arena)
 {
-    if (srcdst != NULL) {
-        // Validacao de erros
-        if (srcdst->channels != 3 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+    if (rle == NULL || blobs == NULL) return 0;
 
-        for (int x = 0; x < srcdst->width; x++) {
-            for (int y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                const long int pos = y * srcdst->bytesperline + x * srcdst->channels;
+    VC_BLOB_ACC* acc = vc_scratch_alloc(arena, MAX(nblobs, 1) * sizeof(VC_BLOB_ACC));
+    if (acc == NULL) return 0;
 
-                //se fosse obter apenas o verde basta apenas colocar a 0 o valor do vermelho e azul
-                srcdst->data[pos] = srcdst->data[pos + 2];	   //vermelho
-                srcdst->data[pos + 1] = srcdst->data[pos + 2]; //verde
-            }
+    vc_blob_acc_init(blobs, acc, nblobs, rle->width, rle->height);
+
+    for (int y = 0; y < rle->height; y++) {
+        const RUN* up = y > 0 ? rle->runs + rle->rowstart[y - 1] : NULL;
+        const RUN* down = y < rle->height - 1 ? rle->runs + rle->rowstart[y + 1] : NULL;
+        const int nup = up ? rle->rowstart[y] - rle->rowstart[y - 1] : 0;
+        const int ndown = down ? rle->rowstart[y + 2] - rle->rowstart[y + 1] : 0;
+        int iu = 0, id = 0;
+
+        for (int i = rle->rowstart[y]; i < rle->rowstart[y + 1]; i++) {
+            const RUN* run = &rle->runs[i];
+            const int len = run->x1 - run->x0 + 1;
+
+            if (run->label <= 0 || run->label > nblobs) continue;
+
+            OVC* blob = &blobs[run->label - 1];
+            VC_BLOB_ACC* a = &acc[run->label - 1];
+
+            blob->label = run->label;
+            blob->area += len;
+
+            // Centro de Gravidade
+            a->sumx += (long long)(run->x0 + run->x1) * len / 2;
+            a->sumy += (long long)y * len;
+
+            // Bounding Box
+            if (blob->x > run->x0) blob->x = run->x0;
+            if (blob->y > y) blob->y = y;
+            if (a->xmax < run->x1) a->xmax = run->x1;
+            if (a->ymax < y) a->ymax = y;
+
+            // Perimetro
+            const int interior = len > 2 ? vc_rle_covered(up, nup, &iu, down, ndown, &id, run->x0 + 1, run->x1 - 1) : 0;
+            blob->perimeter += len - interior;
         }
     }
+    vc_blob_acc_finish(blobs, acc, nblobs);
+
+    vc_scratch_release(arena, acc);
     return 1;
 }
 
 
 /**
- * @brief Converte imagem de grayscale para RGB
+ * @brief Informacao de blobs a partir de uma mascara RLE etiquetada
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
+ * Area, bounding box e centro de massa sao acumulados run a run. Um pixel e de
+ * contorno se algum vizinho-4 for fundo ou estiver fora da imagem; os pixeis
+ * interiores de um run sao os que nao estao nos seus extremos e estao cobertos
+ * pelas linhas de cima e de baixo, o que tambem se conta sobre runs.
+ *
+ * @param rle Mascara RLE (etiquetas compactas 1..nblobs em cada run)
+ * @param blobs Lista de blobs (blobs[i] corresponde a etiqueta i + 1)
+ * @param nblobs Numero de blobs
  * @return int
  */
-int vc_scale_gray_to_rgb(const IVC* src, const IVC* dst)
+int vc_rle_blob_info(const RVC* rle, OVC* blobs, int nblobs)
 {
-    unsigned char* datasrc = src->data;
-    int bytesperline_src = src->width * src->channels;
-    unsigned char* datadst = dst->data;
-    const int height = src->height;
-    int d, i;
-    long int pos_src, pos_dst;
-    unsigned char red[255], green[255], blue[255];
+    return vc_rle_blob_info_scratch(rle, blobs, nblobs, NULL);
+}
 
-    for (d = 0, i = 0; i < 64; i++, d += 4) {
-        red[i] = 0;
-        green[i] = d;
-        blue[i] = 255;
-    }
 
-    for (d = 255, i = 64; i < 128; i++, d -= 4) {
-        red[i] = 0;
-        green[i] = 255;
-        blue[i] = d;
-    }
+/**
+ * @brief Etiquetagem de blobs sobre runs (vizinhanca-8)
+ *
+ * Dois runs de linhas consecutivas pertencem ao mesmo blob se se sobrepuserem ou
+ * tocarem na diagonal. As equivalencias sao resolvidas com union-find sobre os
+ * indices dos runs, pelo que o custo e proporcional ao numero de runs e nao de
+ * pixeis. As etiquetas sao as mesmas de vc_binary_blob_labelling32() (ordem de
+ * varrimento do primeiro pixel) e ficam registadas em cada run. Tambem sao
+ * calculadas as caracteristicas de cada blob (ver vc_rle_blob_info()).
+ *
+ * Com arena, a lista de blobs e a memoria de trabalho vem da arena e sao
+ * libertadas pelo proximo vc_arena_reset(); sem arena (NULL), a lista e alocada
+ * no heap e deve ser libertada com free().
+ *
+ * @param rle Mascara RLE (as etiquetas dos runs sao preenchidas)
+ * @param nlabels Endereco de memoria de uma variavel, onde sera armazenado o numero de etiquetas encontradas.
+ * @param arena Memoria temporaria (NULL = heap)
+ * @return OVC*
+ */
+OVC* vc_rle_blob_labelling_arena(RVC* rle, int* nlabels, AVC* arena)
+{
+    *nlabels = 0;
 
-    for (d = 0, i = 128; i < 192; i++, d += 4) {
-        red[i] = d;
-        green[i] = 255;
-        blue[i] = 0;
+    // Verificacao de erros
+    if (rle == NULL || rle->nruns == 0) return NULL;
+
+    int* parent = vc_scratch_alloc(arena, rle->nruns * sizeof(int));
+    if (parent == NULL) return NULL;
+
+    for (int i = 0; i < rle->nruns; i++) parent[i] = i;
+
+    // Une cada run com os runs da linha anterior que lhe tocam
+    for (int y = 1; y < rle->height; y++) {
+        int j = rle->rowstart[y - 1];
+        const int jend = rle->rowstart[y];
+
+        for (int i = rle->rowstart[y]; i < rle->rowstart[y + 1]; i++) {
+            const RUN* run = &rle->runs[i];
+
+            while (j < jend && rle->runs[j].x1 < run->x0 - 1) j++;
+            for (int k = j; k < jend && rle->runs[k].x0 <= run->x1 + 1; k++) vc_uf_union(parent, i, k);
+        }
     }
 
-    for (d = 255, i = 192; i < 255; i++, d -= 4) {
-        red[i] = 255;
-        green[i] = d;
-        blue[i] = 0;
+    // Resolve as equivalencias: as raizes sao os primeiros runs de cada blob
+    for (int i = 0; i < rle->nruns; i++) {
+        if (parent[i] < i) parent[i] = parent[parent[i]];
+        else parent[i] = ++(*nlabels);
+        rle->runs[i].label = parent[i];
     }
+    vc_scratch_release(arena, parent);
 
-    for (pos_src = 0, pos_dst = 0; pos_src < bytesperline_src * height; pos_src++, pos_dst += 3) {
-        const unsigned char brilho = datasrc[pos_src];
-        datadst[pos_dst] = red[brilho];
-        datadst[pos_dst + 1] = green[brilho];
-        datadst[pos_dst + 2] = blue[brilho];
+    OVC* blobs = vc_scratch_alloc(arena, MAX(*nlabels, 1) * sizeof(OVC));
+    if (blobs != NULL) memset(blobs, 0, *nlabels * sizeof(OVC));
+    if (blobs == NULL || !vc_rle_blob_info_scratch(rle, blobs, *nlabels, arena)) {
+        vc_scratch_release(arena, blobs);
+        *nlabels = 0;
+        return NULL;
     }
 
-    return 1;
+    return blobs;
 }
 
 
 /**
- * @brief Converte imagem de grayscale para binario
+ * @brief Etiquetagem de blobs sobre runs (vizinhanca-8), com a lista de blobs no heap
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @param threshold Limiar
- * @return int
+ * @param rle Mascara RLE (as etiquetas dos runs sao preenchidas)
+ * @param nlabels Endereco de memoria de uma variavel, onde sera armazenado o numero de etiquetas encontradas.
+ * @return OVC* (libertar com free())
  */
-int vc_gray_to_binary(const IVC* src, const IVC* dst, const int threshold)
+OVC* vc_rle_blob_labelling(RVC* rle, int* nlabels)
 {
-    const unsigned char * data_src = (unsigned char*)src->data;
-    unsigned char* data_dst = dst->data;
-    const int width_src = src->width;
-    const int width_dst = dst->width;
-    const int height_src = src->height;
-    const int height_dst = dst->height;
-    const int channels_src = src->channels;
-    const int channel_dst = dst->channels;
-    int bytesperline_src = width_src * channels_src, bytesperline_dst = width_dst * channel_dst;
-
-    if (width_src <= 0 || height_src <= 0 || data_src == NULL) return 0;
-    if (src->levels != 255 || channels_src != 1 || channel_dst != 1) return 0;
-    if (width_src != width_dst || height_src != height_dst) return 0;
+    return vc_rle_blob_labelling_arena(rle, nlabels, NULL);
+}
 
-    for (int y = 0; y < height_src; y++) {
-        for (int x = 0; x < width_src; x++) {
-            const int pos_src = y * bytesperline_src + x * channels_src;
-            const int pos_dst = y * bytesperline_dst + x * channel_dst;
 
-            data_dst[pos_dst] = 255 * (threshold > data_src[pos_src]);
+/**
+ * @brief Acumula um bloco de pixeis em 4 sub-histogramas intercalados
+ *
+ * Pixeis consecutivos vao para sub-histogramas diferentes, pelo que incrementos
+ * seguidos do mesmo nivel (frequentes em zonas uniformes) nao esperam uns pelos
+ * outros.
+ *
+ * @param data Primeiro pixel do bloco
+ * @param bytesperline Distancia entre linhas
+ * @param step Distancia entre pixeis de uma linha (numero de canais)
+ * @param width Largura do bloco
+ * @param y0 Primeira linha
+ * @param y1 Linha seguinte a ultima
+ * @param sub Sub-histogramas
+ */
+static void vc_histogram_block(const unsigned char* data, const int bytesperline, const int step, const int width,
+                               const int y0, const int y1, unsigned int sub[4][256])
+{
+    for (int y = y0; y < y1; y++) {
+        const unsigned char* p = data + (long)y * bytesperline;
+        int x = 0;
+
+        for (; x + 4 <= width; x += 4, p += 4 * step) {
+            sub[0][p[0]]++;
+            sub[1][p[step]]++;
+            sub[2][p[2 * step]]++;
+            sub[3][p[3 * step]]++;
         }
+        for (; x < width; x++, p += step) sub[0][p[0]]++;
     }
-    return 1;
 }
 
 
 /**
- * @brief Converte imagem de grayscale para binario
+ * @brief Histograma de um canal de uma imagem
  *
- * @param srcdst
+ * Serve tanto para imagens em escala de cinza (canal 0) como para um canal de uma
+ * imagem de 3 canais, por exemplo a matiz de um recorte HSV. Com OpenMP e imagens
+ * grandes, as linhas sao divididas pelas threads e os histogramas parciais somados.
+ *
+ * @param src Imagem de entrada
+ * @param channel Canal (0..channels-1)
+ * @param hist Histograma de saida (256 entradas)
  * @return int
  */
-int vc_gray_to_binary_global_mean(const IVC* srcdst)
+int vc_histogram(const IVC* src, const int channel, int* hist)
 {
-    if (srcdst != NULL) {
-        int x, y;
-        long int pos, sum = 0, average = 0;
-
-        // Validacao de erros
-        if (srcdst->channels != 1 || srcdst->width <= 0 || srcdst->height <= 0 || srcdst->data == NULL) return 0;
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || hist == NULL) return 0;
+    if (channel < 0 || channel >= src->channels) return 0;
 
-        for (x = 0; x < srcdst->width; x++) {
-            for (y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                pos = y * srcdst->bytesperline + x * srcdst->channels;
-                sum += srcdst->data[pos];
-            }
-        }
+    memset(hist, 0, 256 * sizeof(int));
 
-        average = sum / (srcdst->width * srcdst->height);
+    const int nt = vc_kernel_threads(src->width, src->height);
+    VC_OMP_PARALLEL(nt)
+    {
+        unsigned int sub[4][256] = { { 0 } };
 
-        for (x = 0; x < srcdst->width; x++) {
-            for (y = 0; y < srcdst->bytesperline + x * srcdst->channels; y++) {
-                pos = y * srcdst->bytesperline + x * srcdst->channels;
-                if (srcdst->data[pos] > average) srcdst->data[pos] = 255;
-                else srcdst->data[pos] = 0;
-            }
+        VC_OMP(for schedule(static))
+        for (int y = 0; y < src->height; y++) {
+            vc_histogram_block(src->data + channel, src->bytesperline, src->channels, src->width, y, y + 1, sub);
         }
+
+        VC_OMP(critical)
+        for (int i = 0; i < 256; i++) hist[i] += (int)(sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i]);
     }
     return 1;
 }
 
 
 /**
- * @brief Converte imagem de grayscale para binario (threshold automatico Midpoint)
+ * @brief Tabela de equalizacao a partir de um histograma (CDF inteira)
+ *
+ * @param hist Histograma (256 entradas)
+ * @param levels Nivel maximo de saida
+ * @param lut Tabela de saida (256 entradas)
+ */
+void vc_histogram_equalization_lut(const int* hist, const int levels, unsigned char* lut)
+{
+    long long n = 0, cdf = 0;
+
+    for (int i = 0; i < 256; i++) n += hist[i];
+
+    for (int i = 0; i < 256; i++) {
+        cdf += hist[i];
+        lut[i] = n > 0 ? (unsigned char)(cdf * levels / n) : (unsigned char)i;
+    }
+}
+
+
+/**
+ * @brief Aplica uma tabela de conversao (LUT) a todos os bytes de uma imagem
  *
  * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @param kernel Tamanho do kernel
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param lut Tabela (256 entradas)
  * @return int
  */
-int vc_gray_to_binary_bernson(const IVC* src, const IVC* dst, const int kernel)
+int vc_image_apply_lut(const IVC* src, const IVC* dst, const unsigned char* lut)
 {
-    unsigned char* datasrc = src->data;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
-    const int offset = (kernel - 1) / 2;
+    const int n = src->width * src->channels;
 
     // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL || lut == NULL) return 0;
     if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels) return 0;
-    if (channels != 1) return 0;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = y * bytesperline + x * channels;
-            int max = 0;
-            int min = 255;
-
-            // NxM Vizinhos
-            for (int ky = -offset; ky <= offset; ky++) {
-                for (int kx = -offset; kx <= offset; kx++) {
-                    if (y + ky >= 0 && y + ky < height && x + kx >= 0 && x + kx < width) {
-                        long int posk = (y + ky) * bytesperline + (x + kx) * channels;
-
-                        //calculo do minimo e do maximo a estudar na vizinhanca
-                        if (datasrc[posk] > max) max = datasrc[posk];
-                        if (datasrc[posk] < min) min = datasrc[posk];
-                    }
-                }
-            }
 
-            //Calculo do midpoint
-            const unsigned char threshold = (unsigned char)((float)(max + min) / (float)2);
-
-            if (datasrc[pos] > threshold) datadst[pos] = 255;
-            else datadst[pos] = 0;
+    const int nt = vc_kernel_threads(src->width, src->height);
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < src->height; y++) {
+        const unsigned char* row = src->data + (long)y * src->bytesperline;
+        unsigned char* out = dst->data + (long)y * dst->bytesperline;
+        int x = 0;
+
+        for (; x + 4 <= n; x += 4) {
+            const unsigned char a = lut[row[x]], b = lut[row[x + 1]], c = lut[row[x + 2]], d = lut[row[x + 3]];
+            out[x] = a;
+            out[x + 1] = b;
+            out[x + 2] = c;
+            out[x + 3] = d;
         }
+        for (; x < n; x++) out[x] = lut[row[x]];
     }
     return 1;
 }
 
 
 /**
- * @brief Dilatacao binaria
+ * @brief Histograma de uma imagem (imagem equalizada pela CDF, escalada para 255)
  *
  * @param src Imagem de entrada
  * @param dst Imagem de saida
- * @param kernel Tamanho do kernel
  * @return int
  */
-int vc_binary_dilate(const IVC* src, const IVC* dst, const int kernel)
+int vc_gray_histogram_show(const IVC* src, const IVC* dst)
 {
-    unsigned char* datasrc = src->data;
-    int bytesperline_src = src->width * src->channels;
-    const int channels_src = src->channels;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    const int offset = kernel / 2;
+    int hist[256];
+    unsigned char lut[256];
 
-    // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
-    if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels) return 0;
-    if (channels_src != 1) return 0;
+    if (src->channels != 1) return 0;
+    if (!vc_histogram(src, 0, hist)) return 0;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            const long int pos = y * bytesperline_src + x * channels_src;
-            int aux = 0;
-
-            // NxM Vizinhos
-            for (int ky = -offset; ky <= offset; ky++) {
-                for (int kx = -offset; kx <= offset; kx++) {
-                    if (y + ky >= 0 && y + ky < height && x + kx >= 0 && x + kx < width) {
-                        long int posk = (y + ky) * bytesperline_src + (x + kx) * channels_src;
-                        if (datasrc[posk] == 255) aux = 255;
-                    }
-                }
-            }
-            if (aux == 255) datadst[pos] = 255;
-            else datadst[pos] = 0;
-        }
-    }
-    return 1;
+    vc_histogram_equalization_lut(hist, 255, lut);
+    return vc_image_apply_lut(src, dst, lut);
 }
 
 
 /**
- * @brief Abertura binaria
+ * @brief Equalizacao de histograma
  *
  * @param src Imagem de entrada
  * @param dst Imagem de saida
- * @param kernel Tamanho do kernel
  * @return int
  */
-int vc_binary_open(const IVC* src, const IVC* dst, const int kernel)
+int vc_histograma_equalization(IVC* src, IVC* dst)
 {
-    int ret = 1;
+    int hist[256];
+    unsigned char lut[256];
 
-    IVC* aux = vc_image_new(src->width, src->height, src->channels, src->levels);
-    ret &= vc_binary_erode(src, aux, kernel);
-    ret &= vc_binary_dilate(aux, dst, kernel);
-    vc_image_free(aux);
+    if (src->channels != 1) return 0;
+    if (!vc_histogram(src, 0, hist)) return 0;
 
-    return ret;
+    vc_histogram_equalization_lut(hist, src->levels, lut);
+    return vc_image_apply_lut(src, dst, lut);
 }
 
 
 /**
- * @brief Fechamento binario
+ * @brief Equalizacao de histograma (na propria imagem)
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @param kernel Tamanho do kernel
+ * @param srcdst Imagem de entrada e saida
  * @return int
  */
-int vc_binary_close(const IVC* src, const IVC* dst, const int kernel)
+int vc_gray_histogram_equalization(IVC* srcdst)
 {
-    int ret = 1;
-
-    IVC* aux = vc_image_new(src->width, src->height, src->channels, src->levels);
-    ret &= vc_binary_dilate(src, aux, kernel);
-    ret &= vc_binary_erode(aux, dst, kernel);
-    vc_image_free(aux);
-
-    return ret;
+    return vc_histograma_equalization(srcdst, srcdst);
 }
 
 
 /**
- * @brief Histograma de uma imagem
+ * @brief Equalizacao adaptativa por blocos com limite de contraste (CLAHE)
+ *
+ * A imagem e dividida em tilesx x tilesy blocos. O histograma de cada bloco e
+ * cortado em cliplimit vezes a altura media (o excesso e distribuido por todos os
+ * niveis) e convertido numa LUT de equalizacao. Cada pixel interpola bilinearmente
+ * as LUTs dos quatro blocos mais proximos, o que evita descontinuidades nas
+ * fronteiras.
  *
  * @param src Imagem de entrada
- * @param dst Imagem de saida
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param tilesx Numero de blocos na horizontal
+ * @param tilesy Numero de blocos na vertical
+ * @param cliplimit Limite de contraste (tipicamente 2 a 4; <= 0 desativa o corte)
  * @return int
  */
-int vc_gray_histogram_show(const IVC* src, const IVC* dst)
+int vc_gray_clahe(const IVC* src, const IVC* dst, const int tilesx, const int tilesy, const float cliplimit)
 {
-    const unsigned char* data = (unsigned char*)src->data;
     const int width = src->width;
     const int height = src->height;
-    int byteperline = src->width * src->channels;
-    const int channels = src->channels;
-    int x, y;
-    long int pos;
-    int contarpixeis[256] = { 0 };
-    float pdf[256];
-    float conta = 0;
-    float max = 0;
-    float cdf[256] = { 0 };
-    float equalizacao[256] = { 0 };
 
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
-    if (channels != 1) return 0;
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+    if (src->channels != 1 || dst->channels != 1) return 0;
+    if (tilesx < 1 || tilesy < 1 || tilesx > width || tilesy > height) return 0;
+
+    const int tw = (width + tilesx - 1) / tilesx;
+    const int th = (height + tilesy - 1) / tilesy;
+    unsigned char* luts = malloc((size_t)tilesx * tilesy * 256);
+    int* tx = malloc(width * sizeof(int));
+    float* ax = malloc(width * sizeof(float));
+
+    if (luts == NULL || tx == NULL || ax == NULL) {
+        free(luts);
+        free(tx);
+        free(ax);
+        return 0;
+    }
 
-    // Numero de pixeis repetidos
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            pos = y * byteperline + x * channels;
-            contarpixeis[(int)data[pos]]++;
+    // LUT de cada bloco
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL_FOR_DYNAMIC(nt)
+    for (int t = 0; t < tilesx * tilesy; t++) {
+        const int x0 = (t % tilesx) * tw, y0 = (t / tilesx) * th;
+        const int w = MIN(tw, width - x0), h = MIN(th, height - y0);
+        unsigned int sub[4][256] = { { 0 } };
+        int hist[256];
+
+        if (w <= 0 || h <= 0) {
+            for (int i = 0; i < 256; i++) luts[t * 256 + i] = (unsigned char)i;
+            continue;
         }
-    }
 
-    // Calcula PDF
-    for (y = 0; y < 256; y++) {
-        pdf[y] = (float)contarpixeis[y] / (float)(width * height);
-        conta += pdf[y];
+        vc_histogram_block(src->data + x0, src->bytesperline, 1, w, y0, y0 + h, sub);
+        for (int i = 0; i < 256; i++) hist[i] = (int)(sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i]);
 
-        if (max < pdf[y]) max = pdf[y];
-    }
+        if (cliplimit > 0.0f) {
+            const int limit = MAX(1, (int)(cliplimit * w * h / 256));
+            int excess = 0;
 
-    // Calcula Grafico CDF
-    for (x = 0; x < 256; x++) {
-        for (y = x; y >= 0; y--) {
-            cdf[x] += pdf[y];
+            for (int i = 0; i < 256; i++) {
+                if (hist[i] > limit) {
+                    excess += hist[i] - limit;
+                    hist[i] = limit;
+                }
+            }
+            for (int i = 0; i < 256; i++) hist[i] += excess / 256 + (i < excess % 256);
         }
+
+        vc_histogram_equalization_lut(hist, 255, luts + t * 256);
     }
 
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            pos = y * byteperline + x * channels;
-            dst->data[pos] = cdf[data[pos]] * 255;
+    // Bloco a esquerda de cada coluna e peso do bloco a direita
+    for (int x = 0; x < width; x++) {
+        const float f = ((float)x + 0.5f) / (float)tw - 0.5f;
+        tx[x] = MIN(MAX((int)floorf(f), 0), tilesx - 1);
+        ax[x] = f <= 0.0f || tx[x] == tilesx - 1 ? 0.0f : f - (float)tx[x];
+    }
+
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < height; y++) {
+        const float f = ((float)y + 0.5f) / (float)th - 0.5f;
+        const int ty0 = MIN(MAX((int)floorf(f), 0), tilesy - 1);
+        const int ty1 = MIN(ty0 + 1, tilesy - 1);
+        const float ay = f <= 0.0f || ty0 == tilesy - 1 ? 0.0f : f - (float)ty0;
+        const unsigned char* row = src->data + (long)y * src->bytesperline;
+        unsigned char* out = dst->data + (long)y * dst->bytesperline;
+
+        for (int x = 0; x < width; x++) {
+            const int tx1 = MIN(tx[x] + 1, tilesx - 1);
+            const unsigned char v = row[x];
+            const float top = (1.0f - ax[x]) * luts[(ty0 * tilesx + tx[x]) * 256 + v] + ax[x] * luts[(ty0 * tilesx + tx1) * 256 + v];
+            const float bot = (1.0f - ax[x]) * luts[(ty1 * tilesx + tx[x]) * 256 + v] + ax[x] * luts[(ty1 * tilesx + tx1) * 256 + v];
+
+            out[x] = (unsigned char)((1.0f - ay) * top + ay * bot + 0.5f);
         }
     }
+
+    free(luts);
+    free(tx);
+    free(ax);
     return 1;
 }
 
 
 /**
- * @brief Equalizacao de histograma
+ * @brief Magnitude do gradiente de um pixel (referencia escalar)
  *
- * @param src Imagem de entrada
- * @param dst Imagem de saida
- * @return int
+ * @param top Linha de cima, na coluna do pixel
+ * @param mid Linha do pixel
+ * @param bot Linha de baixo, na coluna do pixel
+ * @param w Peso central (1 = Prewitt, 2 = Sobel)
+ * @return unsigned char Magnitude truncada e saturada a 255
  */
-int vc_histograma_equalization(IVC* src, IVC* dst)
+static unsigned char vc_edge_pixel(const unsigned char* top, const unsigned char* mid, const unsigned char* bot, const int w)
 {
-    const unsigned char* data = src->data;
-    const int width = src->width;
-    const int height = src->height;
-    int byteperline = src->width * src->channels;
-    const int channels = src->channels;
-    int x, y;
-    long int pos;
-    int contarpixeis[256] = { 0 };
-    float pdf[256];
-    float conta = 0;
-    float max = 0;
-    float cdf[256] = { 0 };
-    float equalizacao[256] = { 0 };
-
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
-    if (channels != 1) return 0;
+    const int gx = (top[1] + w * mid[1] + bot[1]) - (top[-1] + w * mid[-1] + bot[-1]);
+    const int gy = (bot[-1] + w * bot[0] + bot[1]) - (top[-1] + w * top[0] + top[1]);
+    const int ax = abs(gx) / (w + 2);
+    const int ay = abs(gy) / (w + 2);
 
-    // Numero de pixeis repetidos
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            pos = y * byteperline + x * channels;
-            contarpixeis[(int)data[pos]]++;
-        }
-    }
+    return (unsigned char)MIN((int)sqrtf((float)(ax * ax + ay * ay)), 255);
+}
 
-    // Calcula PDF
-    for (y = 0; y < 256; y++) {
-        pdf[y] = (float)contarpixeis[y] / (float)(width * height);
-        conta += pdf[y];
 
-        if (max < pdf[y]) max = pdf[y];
+#ifdef VC_SIMD_SSE2
+/**
+ * @brief Magnitude do gradiente de 8 pixeis consecutivos
+ *
+ * Os gradientes sao calculados em 16 bits; a divisao pela soma dos pesos e feita
+ * sobre o valor absoluto (por 3 com multiplicacao, por 4 com deslocamento), e
+ * gx^2 + gy^2 vem de _mm_madd_epi16. A raiz em float e exata depois de truncada.
+ *
+ * @param top Linha de cima, na coluna do primeiro pixel
+ * @param mid Linha dos pixeis
+ * @param bot Linha de baixo
+ * @param w Peso central (1 = Prewitt, 2 = Sobel)
+ * @return __m128i Magnitudes (16 bits, saturadas a 255)
+ */
+static __m128i vc_edge_sse2_8(const unsigned char* top, const unsigned char* mid, const unsigned char* bot, const int w)
+{
+    const __m128i zero = _mm_setzero_si128();
+#define VC_LOAD8(p) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), zero)
+    const __m128i tl = VC_LOAD8(top - 1), tc = VC_LOAD8(top), tr = VC_LOAD8(top + 1);
+    const __m128i ml = VC_LOAD8(mid - 1), mr = VC_LOAD8(mid + 1);
+    const __m128i bl = VC_LOAD8(bot - 1), bc = VC_LOAD8(bot), br = VC_LOAD8(bot + 1);
+#undef VC_LOAD8
+    const __m128i mls = w == 2 ? _mm_slli_epi16(ml, 1) : ml;
+    const __m128i mrs = w == 2 ? _mm_slli_epi16(mr, 1) : mr;
+    const __m128i tcs = w == 2 ? _mm_slli_epi16(tc, 1) : tc;
+    const __m128i bcs = w == 2 ? _mm_slli_epi16(bc, 1) : bc;
+
+    __m128i gx = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(tr, mrs), br), _mm_add_epi16(_mm_add_epi16(tl, mls), bl));
+    __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(bl, bcs), br), _mm_add_epi16(_mm_add_epi16(tl, tcs), tr));
+
+    gx = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+    gy = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+
+    if (w == 2) {
+        gx = _mm_srli_epi16(gx, 2);
+        gy = _mm_srli_epi16(gy, 2);
+    } else {
+        // floor(g / 3) = (g * 21846) >> 16 para 0 <= g <= 765
+        gx = _mm_mulhi_epu16(gx, _mm_set1_epi16(21846));
+        gy = _mm_mulhi_epu16(gy, _mm_set1_epi16(21846));
     }
 
-    // Calcula grafico CDF
-    for (int i = 1; i < 256; i++) {
-        cdf[i] = cdf[i - 1] + pdf[i];
-    }
+    const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(gx, gy), _mm_unpacklo_epi16(gx, gy));
+    const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(gx, gy), _mm_unpackhi_epi16(gx, gy));
+    const __m128i mlo = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(lo)));
+    const __m128i mhi = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(hi)));
 
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            pos = y * byteperline + x * channels;
-            dst->data[pos] = cdf[data[pos]] * src->levels;
-        }
-    }
-    return 1;
+    return _mm_min_epi16(_mm_packs_epi32(mlo, mhi), _mm_set1_epi16(255));
 }
+#endif
 
 
 /**
- * @brief Detecao de contornos pelos operadores Prewitt
+ * @brief Detecao de contornos (Prewitt ou Sobel) com threshold por percentil
+ *
+ * Numa unica passagem calcula a magnitude do gradiente, normalizada pela soma dos
+ * pesos e saturada a 255, e constroi o histograma das magnitudes. O threshold e o
+ * menor nivel cujo histograma acumulado atinge size * th, aplicado numa segunda
+ * passagem vetorizada. Os pixeis da margem ficam a 0.
  *
  * @param src Imagem de entrada
- * @param dst Imagem de saida
+ * @param dst Imagem de saida (diferente da de entrada)
  * @param th Threshold [0.001, 1.000]
+ * @param w Peso central (1 = Prewitt, 2 = Sobel)
  * @return int
  */
-int vc_gray_edge_prewitt(const IVC* src, const IVC* dst, const float th)
+static int vc_gray_edge(const IVC* src, const IVC* dst, const float th, const int w)
 {
-    unsigned char* datasrc = src->data;
-    unsigned char* datadst = dst->data;
     const int width = src->width;
     const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
     const int size = width * height;
-    int x, y;
-    long int posX;
-    int i;
     int hist[256] = { 0 };
 
     // Verificacao de erros
-    if (src->width <= 0 || src->height <= 0 || src->data == NULL) return 0;
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
     if (src->width != dst->width || src->height != dst->height || src->channels != dst->channels) return 0;
-    if (channels != 1) return 0;
+    if (src->channels != 1 || src->data == dst->data) return 0;
 
-    for (y = 1; y < height - 1; y++) {
-        for (x = 1; x < width - 1; x++) {
-            const long int posA = (y - 1) * bytesperline + (x - 1) * channels;
-            const long int posB = (y - 1) * bytesperline + x * channels;
-            const long int posC = (y - 1) * bytesperline + (x + 1) * channels;
-            const long int posD = y * bytesperline + (x - 1) * channels;
-            const long int posE = y * bytesperline + (x + 1) * channels;
-            const long int posF = (y + 1) * bytesperline + (x - 1) * channels;
-            const long int posG = (y + 1) * bytesperline + x * channels;
-            const long int posH = (y + 1) * bytesperline + (x + 1) * channels;
-            int sumx = datasrc[posA] * -1;
+    memset(dst->data, 0, width);
+    if (height > 1) memset(dst->data + (height - 1) * dst->bytesperline, 0, width);
+    hist[0] = height > 1 ? 2 * width : width;
 
-            posX = y * bytesperline + x * channels;
-            sumx += datasrc[posD] * -1;
-            sumx += datasrc[posF] * -1;
-            sumx += datasrc[posC] * +1;
-            sumx += datasrc[posE] * +1;
-            sumx += datasrc[posH] * +1;
-            sumx = sumx / 3; // 3 = 1 + 1 + 1
+    // Cada thread acumula o histograma das suas linhas; no fim sao somados
+    const int nt = vc_kernel_threads(width, height);
+    VC_OMP_PARALLEL(nt)
+    {
+        int part[256] = { 0 };
 
-            int sumy = datasrc[posA] * -1;
-            sumy += datasrc[posB] * -1;
-            sumy += datasrc[posC] * -1;
-            sumy += datasrc[posF] * +1;
-            sumy += datasrc[posG] * +1;
-            sumy += datasrc[posH] * +1;
-            sumy = sumy / 3; // 3 = 1 + 1 + 1
+        VC_OMP(for schedule(static))
+        for (int y = 1; y < height - 1; y++) {
+            const unsigned char* top = src->data + (y - 1) * src->bytesperline;
+            const unsigned char* mid = src->data + y * src->bytesperline;
+            const unsigned char* bot = src->data + (y + 1) * src->bytesperline;
+            unsigned char* out = dst->data + y * dst->bytesperline;
+            int x = 1;
+
+            out[0] = 0;
+            out[width - 1] = 0;
+            part[0] += width > 1 ? 2 : 1;
+
+#ifdef VC_SIMD_SSE2
+            for (; x + 16 <= width - 1; x += 16) {
+                const __m128i m = _mm_packus_epi16(vc_edge_sse2_8(top + x, mid + x, bot + x, w),
+                                                   vc_edge_sse2_8(top + x + 8, mid + x + 8, bot + x + 8, w));
+                _mm_storeu_si128((__m128i*)(out + x), m);
+                for (int i = 0; i < 16; i++) part[out[x + i]]++;
+            }
+#endif
 
-            datadst[posX] = (unsigned char)sqrt(sumx * sumx + sumy * sumy);
+            for (; x < width - 1; x++) {
+                out[x] = vc_edge_pixel(top + x, mid + x, bot + x, w);
+                part[out[x]]++;
+            }
         }
-    }
 
-    // Compute a grey level histogram
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            hist[datadst[y * bytesperline + x * channels]]++;
-        }
+        VC_OMP(critical)
+        for (int i = 0; i < 256; i++) hist[i] += part[i];
     }
 
-    // Threshold at the middle of the occupied levels
-    int histmax = 0;
+    // Menor nivel que acumula pelo menos size * th pixeis
+    int i, histmax = 0;
     for (i = 0; i <= 255; i++) {
         histmax += hist[i];
-        if (histmax >= (float)size * th) break; // th = Prewitt Threshold
+        if (histmax >= (float)size * th) break;
     }
-    int histthreshold = i;
-
-    // Apply the threshold
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            posX = y * bytesperline + x * channels;
 
-            if (datadst[posX] >= histthreshold) datadst[posX] = 255;
-            else datadst[posX] = 0;
-        }
-    }
+    vc_threshold_ge(dst, dst, i, 255);
     return 1;
 }
 
 
+/**
+ * @brief Detecao de contornos pelos operadores Prewitt
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param th Threshold [0.001, 1.000]
+ * @return int
+ */
+int vc_gray_edge_prewitt(const IVC* src, const IVC* dst, const float th)
+{
+    return vc_gray_edge(src, dst, th, 1);
+}
+
+
+/**
+ * @brief Detecao de contornos pelos operadores Sobel
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @param th Threshold [0.001, 1.000]
+ * @return int
+ */
+int vc_gray_edge_sobel(const IVC* src, const IVC* dst, const float th)
+{
+    return vc_gray_edge(src, dst, th, 2);
+}
+
+
 /**
  * @brief Desenha bounding-box
  *
@@ -1794,7 +5092,7 @@ int vc_gray_edge_prewitt(const IVC* src, const IVC* dst, const float th)
 int vc_desenha_bounding_box_rgb(const IVC* src, const OVC* blobs, int numeroBlobs)
 {
     unsigned char* datasrc = src->data;
-    int bytesperline_src = src->width * src->channels;
+    int bytesperline_src = src->bytesperline;
     const int channels_src = src->channels;
     int width = src->width;
     int height = src->height;
@@ -1834,7 +5132,7 @@ int vc_desenha_bounding_box_rgb(const IVC* src, const OVC* blobs, int numeroBlob
 int vc_desenha_centro_massa_rgb(const IVC* src, const OVC* blobs, int numeroBlobs)
 {
     unsigned char* datasrc = src->data;
-    int bytesperline_src = src->width * src->channels;
+    int bytesperline_src = src->bytesperline;
     const int channels_src = src->channels;
     int width = src->width;
     int height = src->height;
@@ -1860,60 +5158,301 @@ int vc_desenha_centro_massa_rgb(const IVC* src, const OVC* blobs, int numeroBlob
 
 
 /**
- * @brief Passa-baixo de mediana
+ * @brief Copia uma imagem de 1 canal com r pixeis de margem, replicando os extremos
  *
  * @param src Imagem de entrada
+ * @param r Margem (em pixeis, em cada lado)
+ * @return IVC* Imagem de (width + 2r) x (height + 2r)
+ */
+static IVC* vc_gray_pad_replicate(const IVC* src, const int r)
+{
+    IVC* pad = vc_image_new(src->width + 2 * r, src->height + 2 * r, 1, src->levels);
+    if (pad == NULL) return NULL;
+
+    for (int y = 0; y < pad->height; y++) {
+        const unsigned char* row = src->data + MIN(MAX(y - r, 0), src->height - 1) * src->bytesperline;
+        unsigned char* out = pad->data + y * pad->bytesperline;
+
+        memset(out, row[0], r);
+        memcpy(out + r, row, src->width);
+        memset(out + r + src->width, row[src->width - 1], r);
+    }
+    return pad;
+}
+
+
+#ifdef VC_SIMD_SSE2
+// Troca condicional de 16 pares de pixeis: a fica com o minimo e b com o maximo
+#define VC_SORT_SSE2(a, b) { const __m128i t_ = _mm_min_epu8(a, b); b = _mm_max_epu8(a, b); a = t_; }
+
+
+/**
+ * @brief Mediana de 9 vetores de 16 pixeis (rede de 19 comparadores)
+ *
+ * @param p Valores (sao reordenados)
+ * @return __m128i
+ */
+static __m128i vc_median9_sse2(__m128i* p)
+{
+    VC_SORT_SSE2(p[1], p[2]); VC_SORT_SSE2(p[4], p[5]); VC_SORT_SSE2(p[7], p[8]);
+    VC_SORT_SSE2(p[0], p[1]); VC_SORT_SSE2(p[3], p[4]); VC_SORT_SSE2(p[6], p[7]);
+    VC_SORT_SSE2(p[1], p[2]); VC_SORT_SSE2(p[4], p[5]); VC_SORT_SSE2(p[7], p[8]);
+    VC_SORT_SSE2(p[0], p[3]); VC_SORT_SSE2(p[5], p[8]); VC_SORT_SSE2(p[4], p[7]);
+    VC_SORT_SSE2(p[3], p[6]); VC_SORT_SSE2(p[1], p[4]); VC_SORT_SSE2(p[2], p[5]);
+    VC_SORT_SSE2(p[4], p[7]); VC_SORT_SSE2(p[4], p[2]); VC_SORT_SSE2(p[6], p[4]);
+    VC_SORT_SSE2(p[4], p[2]);
+    return p[4];
+}
+
+
+/**
+ * @brief Mediana de n vetores de 16 pixeis por selecao "esquecida"
+ *
+ * Mantem-se um conjunto de n/2 + 2 valores; a cada passo duas passagens de
+ * comparadores levam o maximo e o minimo aos extremos, que sao descartados
+ * (nenhum pode ser a mediana), e entra o valor seguinte.
+ *
+ * @param p Valores (n impar; sao reordenados)
+ * @param n Numero de valores
+ * @return __m128i
+ */
+static __m128i vc_median_forgetful_sse2(__m128i* p, const int n)
+{
+    int lo = 0, hi = n / 2 + 1, next = n / 2 + 2;
+
+    for (;;) {
+        for (int i = lo; i < hi; i++) VC_SORT_SSE2(p[i], p[i + 1]);
+        for (int i = hi - 1; i > lo; i--) VC_SORT_SSE2(p[i - 1], p[i]);
+        lo++;
+        hi--;
+        if (next == n) return p[lo];
+        p[++hi] = p[next++];
+    }
+}
+
+
+/**
+ * @brief Mediana 3x3 ou 5x5 com redes de comparadores, 16 pixeis de cada vez
+ *
+ * @param pad Imagem com margem de r pixeis replicada (largura >= 16 + 2r)
  * @param dst Imagem de saida
- * @return int
+ * @param r Raio do kernel (1 ou 2)
  */
-int vc_gray_lowpass_median_filter(const IVC* src, const IVC* dst)
+static void vc_gray_median_small_sse2(const IVC* pad, const IVC* dst, const int r)
 {
-    unsigned char* datasrc = src->data;
-    unsigned char* datadst = dst->data;
-    const int width = src->width;
-    const int height = src->height;
-    int bytesperline = src->bytesperline;
-    const int channels = src->channels;
-    int mediana[9];
+    const int k = 2 * r + 1;
+    const int nt = vc_kernel_threads(dst->width, dst->height);
 
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            const long int posA = (y - 1) * bytesperline + (x - 1) * channels;
-            const long int posB = (y - 1) * bytesperline + x * channels;
-            const long int posC = (y - 1) * bytesperline + (x + 1) * channels;
-            const long int posD = y * bytesperline + (x - 1) * channels;
-            const long int posX = y * bytesperline + x * channels;
-            const long int posE = y * bytesperline + (x + 1) * channels;
-            const long int posF = (y + 1) * bytesperline + (x - 1) * channels;
-            const long int posG = (y + 1) * bytesperline + x * channels;
-            const long int posH = (y + 1) * bytesperline + (x + 1) * channels;
-
-            mediana[0] = datasrc[posA];
-            mediana[1] = datasrc[posB];
-            mediana[2] = datasrc[posC];
-            mediana[3] = datasrc[posD];
-            mediana[4] = datasrc[posX];
-            mediana[5] = datasrc[posE];
-            mediana[6] = datasrc[posF];
-            mediana[7] = datasrc[posG];
-            mediana[8] = datasrc[posH];
-
-            for (int i = 0; i < 9 - 1; i++) {
-                for (int j = 0; j < i + 1; j++) {
-                    if (mediana[i] > mediana[j]) {
-                        const int aux = mediana[i];
-                        mediana[i] = mediana[j];
-                        mediana[j] = aux;
-                    }
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int y = 0; y < dst->height; y++) {
+        const unsigned char* win = pad->data + y * pad->bytesperline;
+        unsigned char* out = dst->data + y * dst->bytesperline;
+        __m128i p[25];
+
+        // O ultimo bloco sobrepoe-se ao anterior em vez de ter cauda escalar
+        for (int x = 0; x < dst->width; x += 16) {
+            if (x + 16 > dst->width) x = dst->width - 16;
+
+            for (int dy = 0; dy < k; dy++) {
+                for (int dx = 0; dx < k; dx++) p[dy * k + dx] = _mm_loadu_si128((const __m128i*)(win + dy * pad->bytesperline + x + dx));
+            }
+            _mm_storeu_si128((__m128i*)(out + x), r == 1 ? vc_median9_sse2(p) : vc_median_forgetful_sse2(p, 25));
+        }
+    }
+}
+#endif
+
+
+/**
+ * @brief Mediana com histogramas de coluna (Perreault-Hebert), custo constante por pixel
+ *
+ * Cada coluna da imagem com margem mantem o histograma das k linhas da janela
+ * (atualizado com +1/-1 ao descer uma linha). O histograma do kernel tem dois
+ * niveis: 16 classes grossas, atualizadas a cada pixel somando a coluna que entra
+ * e subtraindo a que sai, e 256 classes finas, das quais so o segmento de 16 onde
+ * cai a mediana e atualizado, e apenas quando e preciso.
+ *
+ * Esta funcao trata as linhas [y0, y1) da saida; os histogramas de coluna comecam
+ * com as k - 1 linhas de margem acima da faixa, pelo que faixas diferentes sao
+ * independentes.
+ *
+ * @param pad Imagem com margem de r pixeis replicada
+ * @param dst Imagem de saida
+ * @param r Raio do kernel
+ * @param y0 Primeira linha da faixa
+ * @param y1 Linha seguinte a ultima
+ * @param colfine Memoria para os histogramas finos de coluna (pad->width * 256)
+ * @param colcoarse Memoria para os histogramas grossos de coluna (pad->width * 16)
+ */
+static void vc_gray_median_histogram_band(const IVC* pad, const IVC* dst, const int r, const int y0, const int y1,
+                                          unsigned short* colfine, unsigned short* colcoarse)
+{
+    const int k = 2 * r + 1;
+    const int W = pad->width;
+    const int half = k * k / 2;
+    unsigned short hcoarse[16], hfine[256];
+    int synced[16];
+
+    memset(colfine, 0, (size_t)W * 256 * sizeof(unsigned short));
+    memset(colcoarse, 0, (size_t)W * 16 * sizeof(unsigned short));
+
+    // Histogramas de coluna com as k - 1 linhas acima da primeira linha da faixa
+    for (int y = y0; y < y0 + k - 1; y++) {
+        const unsigned char* row = pad->data + y * pad->bytesperline;
+        for (int x = 0; x < W; x++) {
+            colfine[x * 256 + row[x]]++;
+            colcoarse[x * 16 + (row[x] >> 4)]++;
+        }
+    }
+
+    for (int y = y0; y < y1; y++) {
+        const unsigned char* top = pad->data + y * pad->bytesperline;
+        const unsigned char* bottom = pad->data + (y + k - 1) * pad->bytesperline;
+        unsigned char* out = dst->data + y * dst->bytesperline;
+
+        // Entra a linha de baixo da janela
+        for (int x = 0; x < W; x++) {
+            colfine[x * 256 + bottom[x]]++;
+            colcoarse[x * 16 + (bottom[x] >> 4)]++;
+        }
+
+        memset(hcoarse, 0, sizeof(hcoarse));
+        for (int c = 0; c < k - 1; c++) {
+            for (int b = 0; b < 16; b++) hcoarse[b] += colcoarse[c * 16 + b];
+        }
+        for (int b = 0; b < 16; b++) synced[b] = -k;
+
+        for (int x = 0; x < dst->width; x++) {
+            const unsigned short* cin = colcoarse + (x + k - 1) * 16;
+            for (int b = 0; b < 16; b++) hcoarse[b] += cin[b];
+
+            // Classe grossa da mediana
+            int sum = 0, b = 0;
+            while (sum + hcoarse[b] <= half) sum += hcoarse[b++];
+
+            // Atualiza o segmento fino b para a janela das colunas x..x+k-1
+            unsigned short* seg = hfine + b * 16;
+            if (x - synced[b] < k) {
+                for (int c = synced[b] + 1; c <= x; c++) {
+                    const unsigned short* add = colfine + (c + k - 1) * 256 + b * 16;
+                    const unsigned short* sub = colfine + (c - 1) * 256 + b * 16;
+                    for (int i = 0; i < 16; i++) seg[i] += add[i] - sub[i];
+                }
+            } else {
+                memset(seg, 0, 16 * sizeof(unsigned short));
+                for (int c = x; c < x + k; c++) {
+                    const unsigned short* add = colfine + c * 256 + b * 16;
+                    for (int i = 0; i < 16; i++) seg[i] += add[i];
                 }
             }
-            datadst[posX] = (unsigned char)mediana[4];
+            synced[b] = x;
+
+            int i = 0;
+            while (sum + seg[i] <= half) sum += seg[i++];
+            out[x] = (unsigned char)(b * 16 + i);
+
+            const unsigned short* cout = colcoarse + x * 16;
+            for (int c = 0; c < 16; c++) hcoarse[c] -= cout[c];
+        }
+
+        // Sai a linha de cima da janela
+        for (int x = 0; x < W; x++) {
+            colfine[x * 256 + top[x]]--;
+            colcoarse[x * 16 + (top[x] >> 4)]--;
+        }
+    }
+}
+
+
+/**
+ * @brief Mediana com histogramas de coluna, com as linhas divididas em faixas (uma por thread)
+ *
+ * @param pad Imagem com margem de r pixeis replicada
+ * @param dst Imagem de saida
+ * @param r Raio do kernel
+ * @return int
+ */
+static int vc_gray_median_histogram(const IVC* pad, const IVC* dst, const int r)
+{
+    const int W = pad->width;
+    const int nt = vc_kernel_threads(dst->width, dst->height);
+    const int band = (dst->height + nt - 1) / nt;
+
+    unsigned short* colfine = malloc((size_t)nt * W * 256 * sizeof(unsigned short));
+    unsigned short* colcoarse = malloc((size_t)nt * W * 16 * sizeof(unsigned short));
+
+    if (colfine == NULL || colcoarse == NULL) {
+        free(colfine);
+        free(colcoarse);
+        return 0;
+    }
+
+    VC_OMP_PARALLEL_FOR(nt)
+    for (int t = 0; t < nt; t++) {
+        const int y0 = t * band, y1 = MIN(y0 + band, dst->height);
+
+        if (y0 < y1) {
+            vc_gray_median_histogram_band(pad, dst, r, y0, y1, colfine + (size_t)t * W * 256, colcoarse + (size_t)t * W * 16);
         }
     }
+
+    free(colfine);
+    free(colcoarse);
     return 1;
 }
 
 
+/**
+ * @brief Filtro de mediana com kernel quadrado de tamanho arbitrario
+ *
+ * Os pixeis fora da imagem replicam os da margem. Os kernels 3x3 e 5x5 usam
+ * redes de comparadores SIMD; os restantes (ate 255x255) usam histogramas de
+ * coluna, com custo por pixel independente do tamanho do kernel.
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida (pode ser a de entrada)
+ * @param kernel Tamanho do kernel (impar)
+ * @return int
+ */
+int vc_gray_median_filter(const IVC* src, const IVC* dst, const int kernel)
+{
+    const int r = kernel / 2;
+    int ret = 1;
+
+    // Verificacao de erros
+    if (src->width <= 0 || src->height <= 0 || src->data == NULL || dst->data == NULL) return 0;
+    if (src->width != dst->width || src->height != dst->height) return 0;
+    if (src->channels != 1 || dst->channels != 1) return 0;
+    if (kernel < 1 || kernel > 255 || kernel % 2 == 0) return 0;
+
+    // A copia com margem tambem permite src == dst
+    IVC* pad = vc_gray_pad_replicate(src, r);
+    if (pad == NULL) return 0;
+
+#ifdef VC_SIMD_SSE2
+    if ((kernel == 3 || kernel == 5) && src->width >= 16) vc_gray_median_small_sse2(pad, dst, r);
+    else
+#endif
+    ret = vc_gray_median_histogram(pad, dst, r);
+
+    vc_image_free(pad);
+    return ret;
+}
+
+
+/**
+ * @brief Passa-baixo de mediana (3x3)
+ *
+ * @param src Imagem de entrada
+ * @param dst Imagem de saida
+ * @return int
+ */
+int vc_gray_lowpass_median_filter(const IVC* src, const IVC* dst)
+{
+    return vc_gray_median_filter(src, dst, 3);
+}
+
+
 /**
  * @brief Filtro passa-alto de mediana
  *
@@ -1944,7 +5483,7 @@ int vc_gray_highpass_filter(const IVC* src, const IVC* dst)
             sum += datasrc[posE] * -1;
             sum += datasrc[posG] * -1;
 
-            datadst[posX] = (unsigned char)(sum / 6);
+            datadst[y * dst->bytesperline + x * channels] = (unsigned char)(sum / 6);
         }
     }
     return 1;
@@ -1993,12 +5532,13 @@ int vc_clean_image(const IVC* src, const IVC* dst, const OVC blob) {
     }
 
     // Copiar os dados da imagem de origem para a imagem de destino
-    memcpy(datadst, datasrc, bytesperline * height);
+    for (int y = 0; y < height; y++)
+        memcpy(datadst + y * dst->bytesperline, datasrc + y * bytesperline, (size_t)width * channels);
 
     // Limpar a area do blob na imagem de destino
     for (int y = blob.y; y < blob.y + blob.height; y++) {
         for (int x = blob.x; x < blob.x + blob.width; x++) {
-            const long int pos_blob = y * bytesperline + x * channels;
+            const long int pos_blob = y * dst->bytesperline + x * channels;
 
             if (channels == 1) {
                 datadst[pos_blob] = 0; // Imagem em escala de cinza
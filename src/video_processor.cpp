@@ -2,6 +2,18 @@
 #include "image_processing.h"
 #include "resistor_detection.h"
 #include "utility.h"
+#include "pipeline.h"
+#include "work_stealing_pool.h"
+#include "blob_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+
+#include <sys/stat.h>
 
 
 /**
@@ -24,175 +36,523 @@ void drawBoundingBoxLabelCentroid(cv::Mat& image, const OVC& blob, const std::ve
 }
 
 
+// Resistências do vídeo de referência (videoPath): valor e número de resistências físicas com esse valor
+static const std::vector<std::pair<int, int>> expectedResistorValues = {
+	{220, 1},
+	{1000, 2},
+	{2200, 1},
+	{5600, 1},
+	{10000, 1}
+};
+
+
+// Resistência identificada num frame
+struct Detection {
+    OVC blob;
+    LabelColor labelColor;
+    std::string resistorValue;
+    int trackId = 0;            // Resistência física (BlobTracker)
+    bool confirmed = false;     // Valor confirmado (já não é identificado)
+    bool decoded = false;       // As cores foram identificadas neste frame
+};
+
+// Frame em circulação no pipeline (os buffers são reutilizados de frame para frame)
+struct FrameJob {
+    long index = 0;
+    int currentFrame = 0;
+    cv::Mat frame;              // BGR, anotado no fim
+    cv::Mat frameRGB;
+    std::vector<unsigned char> raw; // Planos YUV lidos de uma entrada Y4M
+    IVC* grayImage = nullptr;
+    BVC* maskBits = nullptr;
+    BVC* closeBits = nullptr;   // Cópia da máscara após o fecho (só com imagens de depuração)
+    RVC* maskRuns = nullptr;
+    std::vector<Detection> detections;
+};
+
+typedef SpscQueue<FrameJob*> FrameQueue;
+
+// Leitura do próximo frame para um buffer (false no fim da entrada)
+typedef std::function<bool(FrameJob*)> FrameReader;
+
+
 /**
- * @brief Função para processar o vídeo
+ * @brief Etapa de descodificação: lê frames para buffers livres e distribui-os pelas etapas de máscara
  *
- * @param cap captura de vídeo
+ * @param read leitura de um frame
+ * @param freeJobs buffers livres (devolvidos pela etapa final)
+ * @param maskIn filas de entrada das etapas de máscara (o frame i vai para a fila i % n)
+ * @param stop pedido de paragem
+ * @param error falha de uma etapa (também termina a leitura)
  */
-void processVideo(cv::VideoCapture& cap) {
-    VideoInfo info = getVideoInfo(cap);
-    std::string str;
-    std::vector<LabelColor> labelsColors;
-    std::set<std::string> uniqueResistors;
-    std::map<std::string, int> resistorMap; // Mapear resistência para número
-    cv::VideoWriter writer(outputPath, cv::VideoWriter::fourcc('a', 'v', 'c', '1'), info.frameRate, cv::Size(info.width, info.height));
-    cv::Mat frame, frameRGB;
-    int framesRead = 0;
-    int resistorCounter = 1;
-	const std::vector<std::pair<int, int>> expectedResistorValues = {
-		{220, 1},
-		{1000, 2},
-		{2200, 1},
-		{5600, 1},
-		{10000, 1}
-	};
-
-    if (!writer.isOpened()) {
-        std::cerr << "Erro ao abrir o ficheiro de saída de vídeo." << std::endl;
-        return;
-    }
-
-    while (cap.read(frame)) {
-        if (frame.empty()) break;
-
-        framesRead++;
-        info.currentFrame = static_cast<int>(cap.get(cv::CAP_PROP_POS_FRAMES));
-
-        cvtColor(frame, frameRGB, cv::COLOR_BGR2RGB); // Frame BGR --> RGB
-
-        // Criação de imagens para processamento
-        IVC* unsegmentedImg = vc_image_new(info.width, info.height, 3, 255);
-        IVC* segmentedImage = vc_image_new(info.width, info.height, 3, 255);
-        IVC* grayImage = vc_image_new(info.width, info.height, 1, 255);
-        IVC* erodedImage = vc_image_new(info.width, info.height, 1, 255);
-        IVC* originalImage = vc_image_new(info.width, info.height, 3, 255);
-
-        // Copia dados do frame para as imagens IVC
-        memcpy(segmentedImage->data, frameRGB.data, info.width * info.height * 3);
-        memcpy(unsegmentedImg->data, frameRGB.data, info.width * info.height * 3);
-        memcpy(originalImage->data, frameRGB.data, info.width * info.height * 3);
-
-        // RGB --> HSV
-        vc_rgb_to_hsv(segmentedImage, unsegmentedImg);
-
-        // Segmentação HSV
-        vc_hsv_segmentation(unsegmentedImg, unsegmentedImg, 15, 360, 30, 100, 30, 100);
-
-        // Conversao imagem segmentada --> escala de cinza
-        vc_rgb_to_gray(unsegmentedImg, grayImage);
-
-        // Operações morfológicas de fechamento usando OpenCV
-        cv::Mat matGrayImage(info.height, info.width, CV_8UC1, grayImage->data);
-        cv::Mat matClosed;
-        morphologyEx(matGrayImage, matClosed, cv::MORPH_CLOSE, cv::Mat(), cv::Point(-1, -1), 25);
-
-        // Copia os dados de volta para a estrutura IVC
-        memcpy(grayImage->data, matClosed.data, info.width * info.height);
-        vc_write_image(const_cast<char*>("Close.pgm"), grayImage);
-
-        // Operação de erosão usando OpenCV
-        cv::Mat matEroded;
-        erode(matClosed, matEroded, cv::Mat(), cv::Point(-1, -1), 5);
-        memcpy(erodedImage->data, matEroded.data, info.width * info.height);
-        vc_write_image(const_cast<char*>("erode.pgm"), erodedImage);
-        int numero;
-
-        // Etiquetamento de blobs na imagem binária
-        OVC* nobjetos = vc_binary_blob_labelling(erodedImage, grayImage, &numero);
-        vc_binary_blob_info(grayImage, nobjetos, numero);
-
-        // Filtragem de blobs por área
-        std::vector<OVC> filteredBlobs;
-        for (int i = 0; i < numero; i++) {
-            if (nobjetos[i].area > 1600) {
-                filteredBlobs.push_back(nobjetos[i]);
+static void decodeStage(const FrameReader& read, FrameQueue& freeJobs, std::vector<std::unique_ptr<FrameQueue>>& maskIn, const std::atomic<bool>& stop,
+                        PipelineError& error) {
+    long index = 0;
+    unsigned spins = 0;
+    FrameJob* job = nullptr;
+
+    while (!stop && !error.failed()) {
+        if (!freeJobs.tryPop(job)) {
+            backoff(spins++);
+            continue;
+        }
+        spins = 0;
+
+        job->index = index;
+        try {
+            if (!read(job)) break;
+        } catch (...) {
+            error.capture();
+            break;
+        }
+
+        index++;
+        maskIn[job->index % maskIn.size()]->push(job);
+    }
+
+    // Fim do vídeo (paragem ou falha): um marcador nulo por etapa de máscara
+    for (auto& queue : maskIn) queue->push(nullptr);
+}
+
+
+/**
+ * @brief Etapa de cor/máscara: RGB --> máscara do primeiro plano --> fecho e erosão --> runs
+ *
+ * @param in fila de entrada
+ * @param out fila de saída
+ * @param foregroundLut tabela de segmentação do primeiro plano
+ * @param foregroundMask intervalos da tabela que pertencem ao primeiro plano
+ * @param raw entrada sem contentor (nulo = frames BGR de uma VideoCapture)
+ * @param error falha de uma etapa (os frames seguintes só passam)
+ */
+static void maskStage(FrameQueue& in, FrameQueue& out, const SVC& foregroundLut, const unsigned int foregroundMask, const RawFrameReader* raw,
+                      PipelineError& error) {
+    while (FrameJob* job = in.pop()) {
+        if (error.failed()) {
+            out.push(job);
+            continue;
+        }
+
+        try {
+            if (raw == nullptr) cvtColor(job->frame, job->frameRGB, cv::COLOR_BGR2RGB); // Frame BGR --> RGB
+
+            // A IVC partilha os dados da cv::Mat em vez de os copiar
+            const IVC original = matToIVC(job->frameRGB);
+
+            // Y4M: planos YUV --> RGB (uma entrada RGB24 já foi lida diretamente para o frame RGB)
+            if (raw != nullptr && !raw->isRGB()) raw->toRGB(job->raw.data(), &original);
+
+            // RGB --> HSV --> segmentação --> máscara em escala de cinza, numa só passagem
+            vc_rgb_to_hsv_mask(&original, job->grayImage, &foregroundLut, foregroundMask);
+
+            // Fecho seguido de erosão com kernels retangulares, sobre a máscara compactada (1 bit/pixel).
+            // Equivalente a 25 e 5 iterações com o kernel 3x3: 51x51 e 11x11.
+            vc_gray_to_bitimage(job->grayImage, job->maskBits);
+            vc_bitimage_close(job->maskBits, job->maskBits, 51, 51);
+            if (job->closeBits) vc_bitimage_copy(job->maskBits, job->closeBits); // Só se for para depuração
+
+            vc_bitimage_erode(job->maskBits, job->maskBits, 11, 11);
+
+            vc_bitimage_to_rle(job->maskBits, job->maskRuns);
+        } catch (...) {
+            error.capture();
+        }
+        out.push(job);
+    }
+    out.push(nullptr);
+}
+
+
+/**
+ * @brief Etapa de análise de blobs: repõe a ordem dos frames, etiqueta os blobs e identifica as resistências
+ *
+ * @param in filas de saída das etapas de máscara
+ * @param out fila de saída
+ * @param window número máximo de frames em circulação (tamanho do buffer de reordenação)
+ * @param dump imagens de depuração (as máscaras dos frames amostrados ou com falhas)
+ * @param error falha de uma etapa (os frames seguintes só passam)
+ */
+static void blobStage(std::vector<std::unique_ptr<FrameQueue>>& in, FrameQueue& out, const size_t window, DebugDump& dump, PipelineError& error) {
+    // Memória temporária de cada frame (lista de blobs, etc.) e imagens reutilizáveis para os recortes
+    AVC* frameArena = vc_arena_new(1 << 20);
+    PVC* imagePool = vc_pool_new();
+    std::vector<OVC> filteredBlobs, candidates;
+    BlobTracker tracker;
+    ReorderBuffer<FrameJob*> reorder(window);
+    size_t finished = 0;
+    std::vector<bool> done(in.size(), false);
+    unsigned spins = 0;
+
+    while (finished < in.size() || !reorder.empty()) {
+        bool idle = true;
+        FrameJob* job = nullptr;
+
+        for (size_t k = 0; k < in.size(); k++) {
+            if (done[k] || !in[k]->tryPop(job)) continue;
+
+            idle = false;
+            if (job == nullptr) {
+                done[k] = true;
+                finished++;
+            } else {
+                reorder.insert(job->index, job);
             }
         }
 
-        // Processamento dos blobs filtrados
-        for (const auto& blob : filteredBlobs) {
-            if (blob.area > 1200 && blob.area < 8000) { // exclui o que não é resistência
-                int x1 = blob.x;
-                int y1 = blob.y;
-                int x2 = blob.x + blob.width;
-                int y2 = blob.y + blob.height;
-
-                // Recorte da imagem original ao redor do blob
-                IVC* cropImg = vc_image_new(x2 - x1, y2 - y1, originalImage->channels, originalImage->levels);
-                for (int y = y1; y < y2; y++) {
-                    for (int x = x1; x < x2; x++) {
-                        int pos_src = (y * originalImage->bytesperline) + (x * originalImage->channels);
-                        int pos_dst = ((y - y1) * cropImg->bytesperline) + ((x - x1) * cropImg->channels);
-                        for (int c = 0; c < originalImage->channels; c++) {
-                            cropImg->data[pos_dst + c] = originalImage->data[pos_src + c];
+        while (reorder.next(job)) {
+            if (error.failed()) {
+                out.push(job);
+                continue;
+            }
+
+            try {
+                ArenaScope frameScope(frameArena);
+                const IVC original = matToIVC(job->frameRGB);
+                int numero;
+
+                // Etiquetamento de blobs sobre os runs da máscara (preenche também área, bounding box e centro de massa)
+                OVC* nobjetos = vc_rle_blob_labelling_arena(job->maskRuns, &numero, frameArena);
+
+                // Filtragem de blobs por área
+                filteredBlobs.clear();
+                for (int i = 0; i < numero; i++) {
+                    if (nobjetos[i].area > 1600) {
+                        filteredBlobs.push_back(nobjetos[i]);
+                    }
+                }
+
+                // Candidatos a resistência
+                candidates.clear();
+                for (const auto& blob : filteredBlobs) {
+                    if (blob.area > 1200 && blob.area < 8000) { // exclui o que não é resistência
+                        candidates.push_back(blob);
+                    }
+                }
+
+                // Associa os candidatos às resistências seguidas: as cores só são identificadas nas
+                // resistências novas ou por confirmar; as confirmadas reutilizam o valor obtido
+                const std::vector<Track*> tracks = tracker.update(candidates);
+
+                bool failed = false;
+                job->detections.clear();
+                for (size_t i = 0; i < candidates.size(); i++) {
+                    const OVC& blob = candidates[i];
+                    Track& track = *tracks[i];
+                    Detection detection;
+
+                    if (track.needsDecode()) {
+                        // Recorte da imagem original ao redor do blob (vista, sem copia de pixeis)
+                        IVC cropImg;
+                        if (!vc_image_view(&cropImg, &original, blob.x, blob.y, blob.width, blob.height)) continue;
+
+                        // Converte o recorte para HSV
+                        PooledImage hsvCropImg(imagePool, cropImg.width, cropImg.height, cropImg.channels, cropImg.levels);
+                        if (!hsvCropImg) continue;
+                        vc_rgb_to_hsv(&cropImg, hsvCropImg.get());
+
+                        // Identifica as cores no recorte HSV
+                        detection.labelColor.label = blob.label;
+                        identifyBlobsColors(hsvCropImg.get(), detection.labelColor.foundColors);
+
+                        // Com as três cores do valor (dígitos e multiplicador), calcula o valor da resistência e vota
+                        // nele; menos cores é uma resistência só em parte visível: não confirma um valor inválido
+                        if (detection.labelColor.foundColors.size() >= 3) {
+                            tracker.vote(track, calculateResistorValue(detection.labelColor.foundColors), detection.labelColor);
+                            detection.decoded = true;
+                        } else {
+                            tracker.fail(track);
+                            failed = true;
                         }
                     }
+                    if (track.resistorValue.empty()) continue;
+
+                    if (!detection.decoded) {
+                        detection.labelColor = track.labelColor;
+                        detection.labelColor.label = blob.label;
+                    }
+                    detection.blob = blob;
+                    detection.resistorValue = track.resistorValue;
+                    detection.trackId = track.id;
+                    detection.confirmed = track.confirmed;
+                    job->detections.push_back(std::move(detection));
                 }
 
-                // Converte o recorte para HSV
-                IVC* hsvCropImg = vc_image_new(cropImg->width, cropImg->height, cropImg->channels, cropImg->levels);
-                vc_rgb_to_hsv(cropImg, hsvCropImg);
+                // Máscaras de depuração: copiadas para a thread de escrita, sem esperar pelo disco
+                if (dump.enabled() && dump.wants(job->index, failed)) {
+                    dump.dump("close", job->index, job->closeBits);
+                    dump.dump("erode", job->index, job->maskBits);
+                }
+            } catch (...) {
+                error.capture();
+            }
+            out.push(job);
+        }
 
-                // Inicializa uma estrutura LabelColor para armazenar as cores encontradas
-                LabelColor labelColor;
-                labelColor.label = blob.label;
+        if (idle) backoff(spins++);
+        else spins = 0;
+    }
+    out.push(nullptr);
 
-                // Identifica as cores no recorte HSV
-                identifyBlobsColors(hsvCropImg, labelColor.foundColors);
+    vc_arena_free(frameArena);
+    vc_pool_free(imagePool);
+}
 
-                // Se cores forem encontradas, calcula o valor da resistência e desenha os rótulos
-                if (!labelColor.foundColors.empty()) {
-                    std::string resistorValue = calculateResistorValue(labelColor.foundColors);
 
-                    labelsColors.push_back(labelColor);
+/**
+ * @brief Etapa de anotação: numera as resistências físicas (por ordem de confirmação) e desenha os rótulos
+ *
+ * @param in fila de entrada
+ * @param out fila de saída
+ * @param info informação do vídeo
+ * @param labelsColors etiquetas e cores analisadas
+ * @param uniqueResistors valores distintos encontrados
+ * @param resistors valor de cada resistência física encontrada
+ * @param render desenhar no frame BGR (há vídeo de saída ou janela)
+ * @param bgr o frame BGR veio da entrada (senão, é obtido do frame RGB, só se for para desenhar)
+ * @param error falha de uma etapa (os frames seguintes só passam)
+ */
+static void annotateStage(FrameQueue& in, FrameQueue& out, VideoInfo info, std::vector<LabelColor>& labelsColors, std::set<std::string>& uniqueResistors,
+                          std::vector<std::string>& resistors, const bool render, const bool bgr, PipelineError& error) {
+    std::map<int, int> resistorMap; // Mapear resistência física para número
+
+    while (FrameJob* job = in.pop()) {
+        if (error.failed()) {
+            out.push(job);
+            continue;
+        }
 
-                    // Verifica se a resistência já foi adicionada
-                    if (uniqueResistors.find(resistorValue) == uniqueResistors.end()) {
-                        // Adiciona a resistência ao conjunto de resistências únicas
-                        uniqueResistors.insert(resistorValue);
+        try {
+            if (render && !bgr) cvtColor(job->frameRGB, job->frame, cv::COLOR_RGB2BGR); // Frame RGB --> BGR
 
-                        // Mapeia a resistência para um número
-                        resistorMap[resistorValue] = resistorCounter;
+            for (const auto& detection : job->detections) {
+                const std::string& resistorValue = detection.resistorValue;
 
-                        // Desenha a bounding box com o número da resistência
-                        drawBoundingBoxLabelCentroid(frame, blob, labelColor.foundColors, "[" + std::to_string(resistorCounter) + "] " + resistorValue);
+                if (detection.decoded) labelsColors.push_back(detection.labelColor);
 
-                        resistorCounter++;
-                    } else {
-                        // Desenha a bounding box usando o número já mapeado
-                        drawBoundingBoxLabelCentroid(frame, blob, labelColor.foundColors, "[" + std::to_string(resistorMap[resistorValue]) + "] " + resistorValue);
-                    }
+                // Enquanto o valor não for confirmado, a resistência é desenhada sem número
+                if (!detection.confirmed) {
+                    if (render) drawBoundingBoxLabelCentroid(job->frame, detection.blob, detection.labelColor.foundColors, resistorValue);
+                    continue;
+                }
+
+                // Verifica se a resistência já foi numerada; se não, mapeia-a para o próximo número
+                auto number = resistorMap.find(detection.trackId);
+                if (number == resistorMap.end()) {
+                    number = resistorMap.emplace(detection.trackId, static_cast<int>(resistors.size()) + 1).first;
+                    resistors.push_back(resistorValue);
+                    uniqueResistors.insert(resistorValue);
+                }
+
+                // Desenha a bounding box com o número da resistência
+                if (render) drawBoundingBoxLabelCentroid(job->frame, detection.blob, detection.labelColor.foundColors, "[" + std::to_string(number->second) + "] " + resistorValue);
+            }
+
+            // Desenhar o texto da informação no centro ao fundo do vídeo
+            if (render) {
+                info.currentFrame = job->currentFrame;
+                drawInfoText(job->frame, info, static_cast<int>(job->index + 1));
+            }
+        } catch (...) {
+            error.capture();
+        }
+        out.push(job);
+    }
+    out.push(nullptr);
+}
+
+
+/**
+ * @brief Função para processar uma sequência de frames
+ *
+ * O processamento decorre em etapas ligadas por filas SPSC limitadas: leitura,
+ * cor/máscara (maskWorkers threads, frames distribuídos de forma alternada), análise
+ * de blobs (que repõe a ordem dos frames), anotação e, na thread que chama, escrita
+ * e (opcionalmente) visualização. Com as etapas em paralelo, o débito aproxima-se do
+ * da etapa mais lenta. Sem visualização não há espera por teclas entre frames.
+ * Uma exceção numa etapa termina o pipeline e é relançada depois de juntar as threads.
+ *
+ * @param info informação do vídeo
+ * @param read leitura de um frame
+ * @param raw entrada sem contentor (nulo = frames BGR de uma VideoCapture)
+ * @param options opções de processamento
+ * @return VideoResult
+ */
+static VideoResult runPipeline(const VideoInfo& info, const FrameReader& read, const RawFrameReader* raw, const ProcessOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    VideoResult result;
+    cv::VideoWriter writer;
+
+    // Tabela de segmentação do primeiro plano (compilada uma única vez)
+    SVC foregroundLut;
+    vc_hsv_lut_init(&foregroundLut);
+    const unsigned int foregroundMask = 1u << vc_hsv_lut_add(&foregroundLut, 15, 360, 30, 100, 30, 100);
+
+    if (!options.outputPath.empty() &&
+        !writer.open(options.outputPath, cv::VideoWriter::fourcc('a', 'v', 'c', '1'), info.frameRate, cv::Size(info.width, info.height))) {
+        std::cerr << "Erro ao abrir o ficheiro de saída de vídeo: " << options.outputPath << std::endl;
+        return result;
+    }
+
+    const int queueDepth = std::max(options.queueDepth, 1);
+    const int maskWorkers = std::max(options.maskWorkers, 1);
+    const bool render = writer.isOpened() || options.display;
+
+    // Buffers dos frames em circulação: os que estão nas filas mais um por etapa em curso
+    const size_t jobCount = static_cast<size_t>(queueDepth) * 2 + maskWorkers + 3;
+    std::vector<FrameJob> jobs(jobCount);
+    FrameQueue freeJobs(jobCount);
+
+    DebugDump dump(options.dumps, info.width, info.height);
+
+    for (auto& job : jobs) {
+        job.grayImage = vc_image_new(info.width, info.height, 1, 255);
+        job.maskBits = vc_bitimage_new(info.width, info.height);
+        job.maskRuns = vc_rle_new(info.width, info.height);
+        if (dump.enabled()) job.closeBits = vc_bitimage_new(info.width, info.height);
+        if (raw != nullptr) {
+            // As entradas sem contentor são lidas diretamente para estes buffers
+            job.frameRGB.create(info.height, info.width, CV_8UC3);
+            if (!raw->isRGB()) job.raw.resize(raw->frameBytes());
+        }
+        freeJobs.push(&job);
+    }
+
+    std::vector<std::unique_ptr<FrameQueue>> maskIn, maskOut;
+    for (int k = 0; k < maskWorkers; k++) {
+        maskIn.emplace_back(new FrameQueue(queueDepth));
+        maskOut.emplace_back(new FrameQueue(queueDepth));
+    }
+    FrameQueue annotateIn(queueDepth), encodeIn(queueDepth);
+    std::atomic<bool> stop(false);
+    PipelineError error; // Uma exceção numa etapa não pode sair da sua thread: é relançada no fim
+
+    std::vector<std::thread> threads;
+    threads.emplace_back(decodeStage, std::cref(read), std::ref(freeJobs), std::ref(maskIn), std::cref(stop), std::ref(error));
+    for (int k = 0; k < maskWorkers; k++) {
+        threads.emplace_back(maskStage, std::ref(*maskIn[k]), std::ref(*maskOut[k]), std::cref(foregroundLut), foregroundMask, raw, std::ref(error));
+    }
+    threads.emplace_back(blobStage, std::ref(maskOut), std::ref(annotateIn), jobCount, std::ref(dump), std::ref(error));
+    threads.emplace_back(annotateStage, std::ref(annotateIn), std::ref(encodeIn), info, std::ref(result.labelsColors), std::ref(result.uniqueResistors), std::ref(result.resistors), render, raw == nullptr,
+                         std::ref(error));
+
+    // Etapa final (thread que chama, por causa da janela): escreve e exibe os frames, já por ordem
+    // (uma exceção aqui também só é relançada depois de juntar as threads)
+    while (FrameJob* job = encodeIn.pop()) {
+        if (!stop && !error.failed()) {
+            try {
+                // Escreve o frame processado no vídeo de saída
+                if (writer.isOpened()) writer.write(job->frame);
+                result.frames++;
+
+                // Exibe o frame processado
+                if (options.display) {
+                    imshow("VC - Resistors", job->frame);
+                    if (cv::waitKey(10) == 'q') stop = true;
                 }
-                vc_image_free(cropImg);
-                vc_image_free(hsvCropImg);
+            } catch (...) {
+                error.capture();
             }
         }
+        freeJobs.push(job);
+    }
 
-        // Desenhar o texto da informação no centro ao fundo do vídeo
-        drawInfoText(frame, info, framesRead);
+    for (auto& thread : threads) thread.join();
+    dump.finish();
 
-        // Escreve o frame processado no vídeo de saída
-        writer.write(frame);
+    if (options.display) cv::destroyWindow("VC - Resistors");
 
-        // Exibe o frame processado
-        imshow("VC - Resistors", frame);
-        if (cv::waitKey(10) == 'q') break;
+    for (auto& job : jobs) {
+        vc_image_free(job.grayImage);
+        vc_bitimage_free(job.maskBits);
+        vc_rle_free(job.maskRuns);
+        vc_bitimage_free(job.closeBits);
     }
 
-    cv::destroyWindow("VC - Resistors");
+    // Libertar o VideoWriter
+    writer.release();
+
+    // Com as threads terminadas e os buffers libertados, a falha de uma etapa chega a quem chamou
+    error.rethrow();
+
+    result.ok = true;
+    result.dumpsWritten = dump.written();
+    result.dumpsDropped = dump.dropped();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+
+/**
+ * @brief Função para processar o vídeo
+ *
+ * @param cap captura de vídeo
+ * @param options opções de processamento
+ * @return VideoResult
+ */
+VideoResult processVideo(cv::VideoCapture& cap, const ProcessOptions& options) {
+    const VideoInfo info = getVideoInfo(cap);
+
+    const FrameReader read = [&cap](FrameJob* job) {
+        if (!cap.read(job->frame) || job->frame.empty()) return false;
+
+        job->currentFrame = static_cast<int>(cap.get(cv::CAP_PROP_POS_FRAMES));
+        return true;
+    };
+
+    VideoResult result = runPipeline(info, read, nullptr, options);
     cap.release();
+    return result;
+}
+
 
+/**
+ * @brief Função para processar frames sem contentor (Y4M ou RGB24 de um ficheiro, pipe ou stdin)
+ *
+ * Não há descodificação: os frames são lidos diretamente para os buffers do pipeline
+ * (RGB24 para o próprio frame RGB, sem conversão de cor; Y4M para os planos YUV,
+ * convertidos na etapa de máscara).
+ *
+ * @param reader entrada aberta
+ * @param options opções de processamento
+ * @return VideoResult
+ */
+VideoResult processVideo(RawFrameReader& reader, const ProcessOptions& options) {
+    VideoInfo info{};
+    info.width = reader.width();
+    info.height = reader.height();
+    info.frameRate = reader.frameRate();
+
+    const FrameReader read = [&reader](FrameJob* job) {
+        unsigned char* dst = reader.isRGB() ? job->frameRGB.data : job->raw.data();
+        if (!reader.read(dst)) return false;
+
+        job->currentFrame = static_cast<int>(job->index + 1);
+        return true;
+    };
+
+    VideoResult result = runPipeline(info, read, &reader, options);
+    reader.close();
+    return result;
+}
+
+
+/**
+ * @brief Função para exibir as resistências e as etiquetas encontradas num vídeo
+ *
+ * @param result resultado do processamento
+ */
+void displayVideoResult(const VideoResult& result) {
     // Imprime as resistências encontradas
     int index = 1;
 	std::cout << "| RESISTÊNCIAS DETETADAS:" << std::endl;
-    for (const auto& resistor : uniqueResistors) {
+    for (const auto& resistor : result.resistors) {
         std::cout << "| --> " << index++ << "º: " << resistor << std::endl;
     }
 	std::cout << "+--------------------------------------------" << std::endl;
 
 	// Imprime as etiquetas e as cores encontradas
 	std::cout << "| LABELS ANALISADAS:" << std::endl;
-	for (const auto& labelColor : labelsColors) {
+	for (const auto& labelColor : result.labelsColors) {
 		std::cout << "| --> #" << labelColor.label << ": ";
 		for (const auto& color : labelColor.foundColors) {
 			std::cout << color.second << " ";
@@ -201,7 +561,246 @@ void processVideo(cv::VideoCapture& cap) {
 	}
 	std::cout << "+--------------------------------------------" << std::endl;
 
+    if (result.dumpsWritten > 0 || result.dumpsDropped > 0) {
+        std::cout << "| IMAGENS DE DEPURAÇÃO: " << result.dumpsWritten << " escritas, " << result.dumpsDropped << " descartadas" << std::endl;
+        std::cout << "+--------------------------------------------" << std::endl;
+    }
+}
+
 
-    // Libertar o VideoWriter
-    writer.release();
+/**
+ * @brief Função para verificar se um ficheiro tem extensão de vídeo
+ *
+ * @param path caminho do ficheiro
+ * @return bool
+ */
+static bool isVideoFile(const std::string& path) {
+    static const char* extensions[] = { ".mp4", ".avi", ".mov", ".mkv", ".y4m" };
+
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+
+    std::string extension = path.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    for (const char* candidate : extensions) {
+        if (extension == candidate) return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief Função para comparar as resistências físicas encontradas com as esperadas no vídeo de referência
+ *
+ * @param result resultado do processamento do vídeo de referência
+ * @return bool (true se cada valor aparece tantas vezes quantas as esperadas)
+ */
+bool checkExpectedResistors(const VideoResult& result) {
+    std::map<int, int> found;
+    for (const auto& resistor : result.resistors) {
+        if (resistor.empty() || !std::isdigit(static_cast<unsigned char>(resistor[0]))) continue; // Sem valor numérico
+        found[std::atoi(resistor.c_str())]++; // "<valor> Ohm  +-5%"
+    }
+
+    bool ok = found.size() == expectedResistorValues.size();
+
+	std::cout << "| RESISTÊNCIAS ESPERADAS / ENCONTRADAS:" << std::endl;
+    for (const auto& expected : expectedResistorValues) {
+        const int count = found.count(expected.first) ? found[expected.first] : 0;
+        ok = ok && count == expected.second;
+
+        std::cout << "| --> " << expected.first << " Ohm: " << expected.second << " / " << count << std::endl;
+    }
+    for (const auto& value : found) {
+        const bool listed = std::any_of(expectedResistorValues.begin(), expectedResistorValues.end(),
+                                        [&value](const std::pair<int, int>& expected) { return expected.first == value.first; });
+        if (!listed) std::cout << "| --> " << value.first << " Ohm: 0 / " << value.second << std::endl;
+    }
+    std::cout << "| " << (ok ? "OK" : "DIFERENTE DO ESPERADO") << std::endl;
+	std::cout << "+--------------------------------------------" << std::endl;
+
+    return ok;
+}
+
+
+/**
+ * @brief Função para verificar se uma entrada é Y4M (frames sem contentor; "-" = stdin)
+ *
+ * @param path caminho do ficheiro
+ * @return bool
+ */
+bool isRawVideoFile(const std::string& path) {
+    if (path == "-") return true;
+    if (path.size() < 4) return false;
+
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".y4m";
+}
+
+
+/**
+ * @brief Função para verificar se um caminho é uma pasta
+ *
+ * @param path caminho
+ * @return bool
+ */
+static bool isDirectory(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFDIR;
+}
+
+
+/**
+ * @brief Função para obter o nome de um ficheiro sem pasta nem extensão
+ *
+ * @param path caminho do ficheiro
+ * @return std::string
+ */
+static std::string videoStem(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    const size_t begin = slash == std::string::npos ? 0 : slash + 1;
+    const size_t dot = path.find_last_of('.');
+    const size_t end = (dot == std::string::npos || dot < begin) ? path.size() : dot;
+
+    return path.substr(begin, end - begin);
+}
+
+
+/**
+ * @brief Função para obter o caminho do vídeo de saída: <nome>_output.mp4, ao lado do vídeo de entrada
+ *
+ * @param path caminho do vídeo de entrada
+ * @return std::string
+ */
+static std::string batchOutputPath(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    const size_t dot = path.find_last_of('.');
+    const size_t stem = (dot == std::string::npos || (slash != std::string::npos && dot < slash)) ? path.size() : dot;
+
+    return path.substr(0, stem) + "_output.mp4";
+}
+
+
+/**
+ * @brief Função para processar vários vídeos sem interface
+ *
+ * Cada entrada pode ser um vídeo ou uma pasta (são processados os vídeos que contém,
+ * exceto as saídas *_output.mp4; os .y4m são lidos sem descodificação). Os vídeos são
+ * tarefas de um conjunto de threads com roubo de trabalho: cada tarefa corre o pipeline completo de um vídeo, com uma thread de
+ * máscara e os kernels em série, para que a máquina seja ocupada por vídeos em simultâneo
+ * e não por threads a disputar o mesmo vídeo.
+ *
+ * @param inputs vídeos e/ou pastas
+ * @param threads número de vídeos processados em simultâneo (0 = um por processador)
+ * @param dumps imagens de depuração (os nomes levam o prefixo <vídeo>_)
+ * @return std::vector<VideoResult> (pela ordem das entradas)
+ */
+std::vector<VideoResult> processBatch(const std::vector<std::string>& inputs, unsigned threads, const DumpOptions& dumps) {
+    std::vector<std::string> paths;
+    std::vector<std::string> errors; // Entradas inválidas: reportadas como falhas, sem interromper as restantes
+
+    for (const auto& input : inputs) {
+        if (isVideoFile(input)) {
+            paths.push_back(input);
+            errors.emplace_back();
+            continue;
+        }
+
+        if (!isDirectory(input)) {
+            paths.push_back(input);
+            errors.emplace_back("não é um vídeo suportado nem uma pasta");
+            continue;
+        }
+
+        std::vector<cv::String> files;
+        try {
+            cv::glob(input + "/*", files, false);
+        } catch (const std::exception& e) {
+            paths.push_back(input);
+            errors.emplace_back(e.what());
+            continue;
+        }
+        std::sort(files.begin(), files.end());
+
+        for (const auto& file : files) {
+            const std::string path = file;
+            if (isVideoFile(path) && path.find("_output.mp4") == std::string::npos) {
+                paths.push_back(path);
+                errors.emplace_back();
+            }
+        }
+    }
+
+    std::vector<VideoResult> results(paths.size());
+    {
+        WorkStealingPool pool(threads);
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            results[i].path = paths[i];
+            results[i].error = errors[i];
+            if (!errors[i].empty()) continue;
+
+            pool.submit([&paths, &results, &dumps, i] {
+                ProcessOptions options;
+                options.outputPath = batchOutputPath(paths[i]);
+                options.display = false;
+                options.dumps = dumps;
+                options.dumps.prefix = videoStem(paths[i]) + "_";
+                options.maskWorkers = 1;
+
+                // Uma exceção (p.ex. do OpenCV) falha apenas este vídeo
+                try {
+                    // Y4M é lido sem contentor nem descodificação; os restantes formatos pela VideoCapture
+                    if (isRawVideoFile(paths[i])) {
+                        RawFrameReader reader;
+                        if (reader.open(paths[i])) results[i] = processVideo(reader, options);
+                    } else {
+                        cv::VideoCapture cap(paths[i]);
+                        if (cap.isOpened()) results[i] = processVideo(cap, options);
+                    }
+                    if (!results[i].ok) results[i].error = "não foi possível abrir ou processar";
+                } catch (const std::exception& e) {
+                    results[i] = VideoResult();
+                    results[i].error = e.what();
+                }
+                results[i].path = paths[i];
+            });
+        }
+        pool.wait();
+    }
+
+    return results;
+}
+
+
+/**
+ * @brief Função para exibir o resumo do processamento de vários vídeos
+ *
+ * @param results resultados do processamento
+ */
+void displayBatchResults(const std::vector<VideoResult>& results) {
+    long totalFrames = 0;
+    int failed = 0;
+
+    std::cout << "+--------------------------------------------" << std::endl;
+    for (const auto& result : results) {
+        std::cout << "| " << result.path << ": ";
+
+        if (!result.ok) {
+            std::cout << "ERRO (" << (result.error.empty() ? "desconhecido" : result.error) << ")" << std::endl;
+            failed++;
+            continue;
+        }
+
+        std::cout << result.frames << " frames, " << result.resistors.size() << " resistências, " << result.seconds << " s" << std::endl;
+        for (const auto& resistor : result.resistors) {
+            std::cout << "|     --> " << resistor << std::endl;
+        }
+        totalFrames += result.frames;
+    }
+    std::cout << "+--------------------------------------------" << std::endl;
+    std::cout << "| VÍDEOS: " << results.size() << " (" << failed << " com erro), FRAMES: " << totalFrames << std::endl;
+    std::cout << "+--------------------------------------------" << std::endl;
 }
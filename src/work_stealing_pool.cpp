@@ -0,0 +1,130 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+
+
+/**
+ * @brief Construtor: cria as threads
+ *
+ * @param threads número de threads (0 = uma por processador)
+ */
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threads; i++) workers_.emplace_back(new Worker());
+    for (unsigned i = 0; i < threads; i++) threads_.emplace_back(&WorkStealingPool::run, this, i);
+}
+
+
+/**
+ * @brief Destrutor: espera que as tarefas terminem e junta as threads
+ */
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_.notify_all();
+
+    for (auto& thread : threads_) thread.join();
+}
+
+
+/**
+ * @brief Função para submeter uma tarefa (as filas recebem tarefas à vez)
+ *
+ * @param task tarefa
+ */
+void WorkStealingPool::submit(std::function<void()> task) {
+    Worker& worker = *workers_[next_++ % workers_.size()];
+
+    pending_++;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_++;
+    }
+    work_.notify_one();
+}
+
+
+/**
+ * @brief Função para esperar que todas as tarefas submetidas terminem
+ */
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+
+/**
+ * @brief Função para retirar a tarefa mais recente da fila da própria thread
+ *
+ * @param index índice da thread
+ * @param task tarefa retirada
+ * @return bool
+ */
+bool WorkStealingPool::popLocal(size_t index, std::function<void()>& task) {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+
+    if (worker.tasks.empty()) return false;
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+
+/**
+ * @brief Função para roubar a tarefa mais antiga da fila de outra thread
+ *
+ * @param thief índice da thread que rouba
+ * @param task tarefa roubada
+ * @return bool
+ */
+bool WorkStealingPool::steal(size_t thief, std::function<void()>& task) {
+    for (size_t k = 1; k < workers_.size(); k++) {
+        Worker& victim = *workers_[(thief + k) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief Ciclo de cada thread: executa tarefas enquanto houver e adormece quando não há
+ *
+ * @param index índice da thread
+ */
+void WorkStealingPool::run(size_t index) {
+    for (;;) {
+        std::function<void()> task;
+
+        if (popLocal(index, task) || steal(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queued_--;
+            }
+            task();
+
+            if (--pending_ == 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+        if (stopping_ && queued_ == 0) return;
+    }
+}